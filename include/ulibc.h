@@ -39,7 +39,8 @@
  *   Usage: ULBIC_AVOID_HTCORE=1 ./a.out
  *
  * ULIBC_AFFINITY (default: scatter:core)
- *   set affinity-types {scatter, compact} and affinity-bind-levels {socket, core, thread, fine}
+ *   set affinity-types {scatter, compact, capacity_scatter, capacity_compact}
+ *   and affinity-bind-levels {socket, llc, core, thread, fine}
  *   Usage: ULIBC_AFFINITY=compact:fine ./a.out
  *
  * ULIBC_USE_SCHED_AFFINITY (default: 0)
@@ -55,8 +56,49 @@
  *   Usage: ULIBC_VERBOSE=1 ./a.out
  *
  * ULIBC_MEMBIND (default: '')
- *   node list for memory binding
+ *   [policy:]node list for memory binding
+ *   policy = {default,bind,interleave,weighted_interleave,chunk_interleave,
+ *             preferred,preferred_many,local}
  *   Usage: ULIBC_MEMBIND=0-2,3 ./a.out
+ *          ULIBC_MEMBIND=preferred_many:0,1 ./a.out
+ *
+ * ULIBC_MEMBIND_WEIGHTS (default: '')
+ *   node:weight list for ULIBC_MPOL_WEIGHTED_INTERLEAVE (unlisted nodes: 1)
+ *   Usage: ULIBC_MEMBIND_WEIGHTS=0:3,1:1 ./a.out
+ *
+ * ULIBC_SPILL_RESERVE (default: -1)
+ *   ULIBC_malloc_bind() binds to the nearest node having MemFree of
+ *   size + N bytes if the node is short (-1: disabled)
+ *   Usage: ULIBC_SPILL_RESERVE=1073741824 ./a.out
+ *
+ * ULIBC_TOUCH_ASYNC (default: 0)
+ *   touches new allocations in the background by a worker on each node
+ *   Usage: ULIBC_TOUCH_ASYNC=1 ./a.out
+ *
+ * ULIBC_STATS_JSON (default: '')
+ *   writes allocation statistics in JSON to the file at ULIBC_finalize()
+ *   Usage: ULIBC_STATS_JSON=stats.json ./a.out
+ *          ULIBC_STATS_JSON=stdout ./a.out
+ *
+ * ULIBC_INTERLEAVE_CHUNK (default: 1048576)
+ *   chunk size in bytes for ULIBC_MPOL_CHUNK_INTERLEAVE
+ *   Usage: ULIBC_INTERLEAVE_CHUNK=262144 ./a.out
+ *
+ * ULIBC_PAGESIZE (default: default)
+ *   page size for memory allocation {default, base, thp, 2m, 1g}
+ *   Usage: ULIBC_PAGESIZE=thp ./a.out
+ *
+ * ULIBC_TOUCH (default: stride)
+ *   first-touch strategy {stride, populate}
+ *   Usage: ULIBC_TOUCH=populate ./a.out
+ *
+ * ULIBC_CACHE_BYTES (default: 0)
+ *   byte limit of freed mappings kept for reuse (0: disabled)
+ *   Usage: ULIBC_CACHE_BYTES=1073741824 ./a.out
+ *
+ * ULIBC_TOPOLOGY_CACHE (default: '')
+ *   file keeping the processor topology for later processes on the same boot
+ *   Usage: ULIBC_TOPOLOGY_CACHE=/tmp/ulibc_topology ./a.out
  *
  * ------------------------------------------------------------------------------- */
 
@@ -67,7 +109,52 @@ extern "C" {
     ULIBC_MPOL_DEFAULT    = (0),
     ULIBC_MPOL_BIND       = (1),
     ULIBC_MPOL_INTERLEAVE = (2),
-    ULIBC_MPOL_MAX        = (3),
+    ULIBC_MPOL_WEIGHTED_INTERLEAVE = (3),
+    ULIBC_MPOL_CHUNK_INTERLEAVE = (4),
+    ULIBC_MPOL_PREFERRED  = (5),
+    ULIBC_MPOL_PREFERRED_MANY = (6),
+    ULIBC_MPOL_LOCAL      = (7),
+    ULIBC_MPOL_MAX        = (8),
+  };
+  enum ulibc_page_t {
+    ULIBC_PAGE_DEFAULT = (0),	/* system default */
+    ULIBC_PAGE_BASE    = (1),	/* base pages only */
+    ULIBC_PAGE_THP     = (2),	/* transparent huge pages */
+    ULIBC_PAGE_HUGE_2M = (3),	/* hugetlbfs 2 MB pages */
+    ULIBC_PAGE_HUGE_1G = (4),	/* hugetlbfs 1 GB pages */
+    ULIBC_PAGE_MAX     = (5),
+  };
+  enum ulibc_touch_t {
+    ULIBC_TOUCH_STRIDE   = (0),	/* writes a byte per page */
+    ULIBC_TOUCH_POPULATE = (1),	/* madvise(MADV_POPULATE_WRITE) */
+    ULIBC_TOUCH_MAX      = (2),
+  };
+  enum ulibc_mmap_flag_t {
+    ULIBC_MMAP_PRIVATE  = (0x00),	/* copy-on-write mapping */
+    ULIBC_MMAP_SHARED   = (0x01),	/* writes go to the file */
+    ULIBC_MMAP_PREFAULT = (0x02),	/* reads the pages in from the nodes' threads */
+  };
+  enum ulibc_print_t {
+    ULIBC_PRINT_ATTR      = (0),	/* allocation attributes */
+    ULIBC_PRINT_RESIDENCY = (1),	/* attributes and actual page placement */
+  };
+  enum ulibc_stats_t {
+    ULIBC_STATS_TOTAL   = (0),	/* all allocations */
+    ULIBC_STATS_NODE    = (1),	/* per NUMA node */
+    ULIBC_STATS_MPOL    = (2),	/* per ULIBC_MPOL_* */
+    ULIBC_STATS_ROUTINE = (3),	/* per allocation routine */
+  };
+  struct ulibc_alloc_stats_t {
+    size_t bytes;		/* live bytes */
+    size_t peak_bytes;		/* high watermark of bytes */
+    size_t count;		/* live allocations */
+    size_t nallocs;		/* #allocations */
+    size_t nfrees;		/* #frees */
+    double alloc_rate;		/* allocations per second since ULIBC_init() */
+    double free_rate;		/* frees per second since ULIBC_init() */
+    double mmap_msecs;		/* time in mmap (ULIBC_STATS_TOTAL only) */
+    double mbind_msecs;		/* time in mbind (ULIBC_STATS_TOTAL only) */
+    double touch_msecs;		/* time in first-touch (ULIBC_STATS_TOTAL only) */
   };
 
   /* tools.c (beta) */
@@ -79,17 +166,73 @@ extern "C" {
   /* linux_numa_malloc.c (beta) */
   const char *ULIBC_get_mempol_mode_name(int mode);
   void ULIBC_print_memory_pool(void);
+  void ULIBC_print_memory_pool_mode(int mode);
+  size_t ULIBC_query_placement(const void *ptr, size_t len, size_t *per_node_bytes);
+  int ULIBC_migrate(void *ptr, size_t len, int node);
+  int ULIBC_rebind(void *ptr, int mpol, unsigned long *nodemask);
+  int ULIBC_get_interleave_weight(int node);
+  void ULIBC_set_interleave_weights(const int *weights, int nnodes);
+  long ULIBC_get_spill_reserve(void);
+  void ULIBC_set_spill_reserve(long bytes);
+  int ULIBC_get_spilled_node(const void *ptr);
+  size_t ULIBC_get_interleave_chunk(void);
+  void ULIBC_set_interleave_chunk(size_t chunk);
+  size_t ULIBC_get_interleave_unit(const void *base);
+  int ULIBC_get_interleave_node(const void *base, size_t offset);
+  void *ULIBC_malloc_chunk_interleave(size_t size, size_t chunk, unsigned long *nodemask);
+  void *ULIBC_mmap_file(const char *path, size_t offset, size_t len, int mpol,
+			unsigned long *nodemask, int flags);
+  void *ULIBC_shm_create(const char *name, size_t size, int mpol, unsigned long *nodemask);
+  void *ULIBC_shm_attach(const char *name, size_t size, int mpol, unsigned long *nodemask);
+  size_t ULIBC_shm_size(const char *name);
+  int ULIBC_shm_unlink(const char *name);
+  size_t ULIBC_get_cache_limit(void);
+  void ULIBC_set_cache_limit(size_t bytes);
+  size_t ULIBC_get_cached_bytes(void);
+  size_t ULIBC_trim_cache(size_t bytes);
+  int ULIBC_get_alloc_stats(int kind, int index, struct ulibc_alloc_stats_t *stats);
+  void ULIBC_print_alloc_stats(FILE *fp);
+  struct ulibc_partition_t {
+    void *addr;			/* head address */
+    size_t nelems;		/* number of elements */
+    size_t elemsize;		/* element size in bytes */
+    int nnodes;			/* number of online NUMA nodes */
+  };
+  void *ULIBC_malloc_partitioned(size_t nelems, size_t elemsize, struct ulibc_partition_t *part);
+  void ULIBC_partition_range(const struct ulibc_partition_t *part, int node, int64_t *ls, int64_t *le);
+  int ULIBC_partition_node(const struct ulibc_partition_t *part, size_t index);
+  int ULIBC_partition_thread(const struct ulibc_partition_t *part, size_t index);
   void ULIBC_touch_memory_pool(void);
   void ULIBC_touch_memory_pool_naive(void);
+  int ULIBC_get_touch_async(void);
+  void ULIBC_set_touch_async(int async);
+  int ULIBC_touch_async(void *ptr);
+  void ULIBC_touch_memory_pool_async(void);
+  int ULIBC_wait_touched(void *ptr);
   size_t ULIBC_memory_usage_node(unsigned long maxnode, size_t *usage);
   size_t ULIBC_memory_usage(void);
   void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode);
+  void *ULIBC_malloc_explict_page(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode, int page);
   void *ULIBC_malloc_mempol(size_t size, int mpol);
   void *ULIBC_malloc_bind(size_t size, int node);
   void *ULIBC_malloc_interleave(size_t size);
+  void *ULIBC_calloc_explict(size_t nmemb, size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode);
+  void *ULIBC_calloc_mempol(size_t nmemb, size_t size, int mpol);
+  void *ULIBC_calloc_bind(size_t nmemb, size_t size, int node);
+  void *ULIBC_calloc_interleave(size_t nmemb, size_t size);
+  void *ULIBC_parallel_memcpy(void *dst, const void *src, size_t n);
+  void *ULIBC_parallel_memset(void *dst, int c, size_t n);
   void ULIBC_free(void *ptr);
   void ULIBC_all_free(void);
   void ULIBC_finalize(void);
+  const char *ULIBC_get_mempol_name(int mpol);
+  const char *ULIBC_get_page_name(int page);
+  int ULIBC_get_page_policy(void);
+  void ULIBC_set_page_policy(int page);
+  size_t ULIBC_get_backing_page_size(void *addr);
+  const char *ULIBC_get_touch_name(int touch);
+  int ULIBC_get_touch_policy(void);
+  void ULIBC_set_touch_policy(int touch);
   
   /* init.c */
   int ULIBC_init(void);
@@ -102,7 +245,11 @@ extern "C" {
   int ULIBC_get_num_cores(void);
   int ULIBC_get_num_smts(void);
   size_t ULIBC_page_size(unsigned nodeidx);
+  long ULIBC_get_nr_hugepages(unsigned nodeidx, size_t pagesize);
+  long ULIBC_get_free_hugepages(unsigned nodeidx, size_t pagesize);
   size_t ULIBC_memory_size(unsigned nodeidx);
+  size_t ULIBC_free_memory_size(unsigned nodeidx);
+  int ULIBC_get_node_distance(unsigned a, unsigned b);
   size_t ULIBC_total_memory_size(void);
   size_t ULIBC_align_size(void);
   struct cpuinfo_t {
@@ -110,8 +257,30 @@ extern "C" {
     int node;			/* Package ID */
     int core;			/* Core ID */
     int smt;			/* SMT ID */
+    int type;			/* Core type (ulibc_core_type_t) */
+    int capacity;		/* Relative performance (1024: fastest) */
+  };
+  enum ulibc_core_type_t {
+    ULIBC_CORE_PERFORMANCE = (0), /* P-core, big core, or homogeneous */
+    ULIBC_CORE_EFFICIENCY  = (1), /* E-core or LITTLE core */
   };
   struct cpuinfo_t ULIBC_get_cpuinfo(unsigned procidx);
+  enum ulibc_cache_type_t {
+    ULIBC_CACHE_NONE    = (0),	/* not available */
+    ULIBC_CACHE_DATA    = (1),	/* data cache */
+    ULIBC_CACHE_UNIFIED = (2),	/* unified cache */
+  };
+  struct cacheinfo_t {
+    int level;			/* Cache level (0: not available) */
+    int type;			/* ULIBC_CACHE_* */
+    size_t size;		/* size in bytes */
+    int line;			/* line size in bytes */
+    int ways;			/* associativity (0: unknown) */
+    int leader;			/* lowest Processor ID sharing this cache */
+    int nshared;		/* number of Processors sharing this cache */
+  };
+  struct cacheinfo_t ULIBC_get_cache_info(int level, unsigned procidx);
+  int ULIBC_get_cache_levels(void);
   
   /* print functions */
   void ULIBC_print_topology(FILE *fp);
@@ -140,6 +309,12 @@ extern "C" {
   int ULIBC_get_online_nodes(void);
   int ULIBC_get_online_cores(int node);
   int ULIBC_get_online_nodeidx(int node);
+  int ULIBC_get_online_thread(int node, int core);
+  int ULIBC_get_nearest_nodes(int node, int *order);
+  int ULIBC_get_cache_threads(int level, int tid, int *tids);
+  int ULIBC_get_online_llcs(void);
+  int ULIBC_get_online_llc_cores(int llc);
+  int ULIBC_get_online_llc_thread(int llc, int core);
 
   int ULIBC_get_num_threads(void);
   void ULIBC_set_num_threads(int nt);
@@ -151,11 +326,14 @@ extern "C" {
   enum map_policy_t {
     SCATTER_MAPPING = 0x00,
     COMPACT_MAPPING = 0x01,
+    CAPACITY_SCATTER_MAPPING = 0x02,
+    CAPACITY_COMPACT_MAPPING = 0x03,
   };
   enum bind_level_t {
     THREAD_TO_THREAD = 0x00,
     THREAD_TO_CORE   = 0x01,
     THREAD_TO_SOCKET = 0x02,
+    THREAD_TO_LLC    = 0x03,
   };
   int ULIBC_set_affinity_policy(int nt, int map, int bind);
   struct numainfo_t {
@@ -164,6 +342,8 @@ extern "C" {
     int node;		      /* NUMA node ID */
     int core;		      /* NUMA core ID */
     int lnp;		      /* Number of NUMA cores in NUMA node */
+    int llc;		      /* LLC ID */
+    int llc_core;	      /* LLC-local core ID */
   };
   struct numainfo_t ULIBC_get_numainfo(int tid);
   struct numainfo_t ULIBC_get_current_numainfo(void);
@@ -171,17 +351,51 @@ extern "C" {
   /* threading */
   int ULIBC_bind_thread(void);
   int ULIBC_bind_thread_explicit(int threadid);
+  int ULIBC_bind_node(int node);
   int ULIBC_unbind_thread(void);
   int ULIBC_is_bind_thread(int proc);
   void ULIBC_clear_numa_loop(int64_t loopstart, int64_t loopend);
   int ULIBC_numa_loop(int64_t chunk, int64_t *start, int64_t *end);
+  void ULIBC_numa_range(int64_t len, int64_t off, int node, int64_t *ls, int64_t *le);
+  void ULIBC_thread_range(int64_t len, int64_t off, int tid, int64_t *ls, int64_t *le);
+  void ULIBC_clear_llc_loop(int64_t loopstart, int64_t loopend);
+  int ULIBC_llc_loop(int64_t chunk, int64_t *start, int64_t *end);
   
   /* barrier */
   void ULIBC_barrier(void);
   void ULIBC_node_barrier(void);  
+  void ULIBC_llc_barrier(void);
   void ULIBC_pair_barrier(int node_s, int node_t);
   void ULIBC_hierarchical_barrier(void);
   
+  /* numa_slab.c */
+  void *ULIBC_node_alloc(size_t size, int node);
+  void ULIBC_node_free(void *ptr);
+  
+  /* numa_probe.c */
+  enum ulibc_probe_t {
+    ULIBC_PROBE_LATENCY  = (0),	/* pointer-chase latency in ns */
+    ULIBC_PROBE_READ_BW  = (1),	/* streaming read bandwidth in GB/s */
+    ULIBC_PROBE_WRITE_BW = (2),	/* streaming write bandwidth in GB/s */
+    ULIBC_PROBE_MAX      = (3),
+  };
+  int ULIBC_probe_distance(size_t bytes);
+  int ULIBC_probe_distance_cached(const char *path, size_t bytes);
+  int ULIBC_get_probe_nodes(void);
+  double ULIBC_get_probe(int kind, int from, int to);
+  const char *ULIBC_get_probe_name(int kind);
+  int ULIBC_save_probe(const char *path);
+  int ULIBC_load_probe(const char *path);
+  void ULIBC_print_probe(FILE *fp);
+  
+  /* numa_replica.c */
+  struct ulibc_replica_t;
+  struct ulibc_replica_t *ULIBC_replicate(const void *src, size_t size);
+  void ULIBC_replica_refresh(struct ulibc_replica_t *r, const void *src);
+  void *ULIBC_replica_local(const struct ulibc_replica_t *r);
+  void *ULIBC_replica_node(const struct ulibc_replica_t *r, int node);
+  void ULIBC_replica_free(struct ulibc_replica_t *r);
+  
   /* malloc */
   char *ULIBC_get_memory_name(void);
   void *NUMA_malloc(size_t size, const int onnode);
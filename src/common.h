@@ -41,9 +41,18 @@
 #ifndef MAX_CPUS
 #  define MAX_CPUS 4096
 #endif
+#ifndef MAX_CACHE_LEVELS
+#  define MAX_CACHE_LEVELS 4
+#endif
+#ifndef CPU_CAPACITY_SCALE
+#  define CPU_CAPACITY_SCALE 1024
+#endif
 #ifndef SQRT_MAX_NODES
 #  define SQRT_MAX_NODES 16
 #endif
+#ifndef CACHELINE_SIZE
+#  define CACHELINE_SIZE 64
+#endif
 
 /* macro functions */
 #ifndef ROUNDUP
@@ -116,6 +125,10 @@ extern "C" {
   int ULIBC_init_barriers(void);
   int ULIBC_init_numa_threads(void);
   int ULIBC_init_numa_loops(void);
+  void ULIBC_clear_node_alloc(void);
+  void ULIBC_clear_numa_loops(void);
+  void ULIBC_clear_numa_barriers(void);
+  int ULIBC_mark_touched(void *ptr);
 #if defined (__cplusplus)
 }
 #endif
@@ -34,6 +34,11 @@ static const char *get_mempol_mode_name(int mode) {
   }
 }
 
+static int get_mempol_mode(int mode) {
+  (void)mode;
+  return ULIBC_MPOL_DEFAULT;
+}
+
 #include "numa_malloc.c"
 
 /* ------------------------------------------------------------
@@ -43,24 +48,43 @@ static const char *get_mempol_mode_name(int mode) {
 #  define ROUNDUP2M(x) ROUNDUP(x,1UL<<21)
 #endif
 
-void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+static void *malloc_explict_stripe(size_t size, int mpol, unsigned long *nodemask,
+				   unsigned long maxnode, int page, size_t unit) {
   void *p;
+  int routine;
+  struct mattr_node_t *c = NULL;
+  if ( !is_striped_mpol(mpol) )
+    c = reuse_cached_mattr(size, mpol, nodemask, maxnode, page);
+  if ( c ) return c->addr;
+  
+  if ( page != ULIBC_PAGE_DEFAULT ) {
+    p = mmap_page_policy(&size, &page, nodemask, maxnode);
+    routine = ULIBC_MMAP;
+    if ( !p ) return NULL;
+  } else {
 #ifdef USE_MALLOC
-  p = malloc(size);
+    p = malloc(size);
+    routine = ULIBC_MALLOC;
 #else
-  posix_memalign((void *)&p, ULIBC_align_size(), size);
+    posix_memalign((void *)&p, ULIBC_align_size(), size);
+    routine = ULIBC_POSIX_MEMALIGN;
 #endif
+  }
   
-  struct mattr_node_t *m = insert_mattr( &__mattr_tree_root, size, p );
+  struct mattr_node_t *m = insert_mattr( size, p );
   m->touched = 0;
-#ifdef USE_MALLOC
-  m->routine = ULIBC_MALLOC;
-#else
-  m->routine = ULIBC_POSIX_MEMALIGN;
-#endif
+  m->routine = routine;
   m->mpol    = mpol;
+  m->page    = page;
   m->maxnode = maxnode;
   memcpy( m->nodemask, nodemask, maxnode/sizeof(unsigned long) );
+  if ( is_striped_mpol(mpol) &&
+       stripe_mattr_node(m, mpol, nodemask, maxnode, unit) && unit ) {
+    release_mattr_node( delete_mattr(p) );
+    return NULL;
+  }
+  stats_alloc(m, mpol);
+  async_touch_new(m);
   
   if ( ULIBC_verbose() > 1 ) {
     printf("ULIBC: allocate ");
@@ -71,14 +95,13 @@ void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsig
   return p;
 }
 
+void *ULIBC_malloc_explict_page(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode, int page) {
+  return malloc_explict_stripe(size, mpol, nodemask, maxnode, page, 0);
+}
+
 void *ULIBC_malloc_mempol(size_t size, int mpol) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  const char *descnode = getenv("ULIBC_MEMBIND");
-  if ( descnode ) {
-    make_nodemask_sscanf(descnode, MAX_NODES, nodemask);
-  } else {
-    make_nodemask_online(MAX_NODES, nodemask);
-  }
+  mpol = membind_nodemask(mpol, nodemask);
   size = ROUNDUP2M( size );
   void *p = ULIBC_malloc_explict(size, mpol, nodemask, MAX_NODES);
   return p;
@@ -86,9 +109,11 @@ void *ULIBC_malloc_mempol(size_t size, int mpol) {
 
 void *ULIBC_malloc_bind(size_t size, int node) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  SET_BITMAP( (uint64_t *)nodemask, ULIBC_get_online_nodeidx(node) );
   size = ROUNDUP2M( size );
+  const int k = spill_node(size, node);
+  SET_BITMAP( (uint64_t *)nodemask, ULIBC_get_online_nodeidx(k) );
   void *p = ULIBC_malloc_explict(size, ULIBC_MPOL_DEFAULT, nodemask, MAX_NODES);
+  mark_spilled(p, node, k);
   return p;
 }
 
@@ -101,16 +126,29 @@ void *ULIBC_malloc_interleave(size_t size) {
 }
 
 
+static long query_page_nodes(unsigned long count, void **pages, int *status) {
+  (void)count, (void)pages, (void)status;
+  return -1;
+}
+
+static long move_page_nodes(unsigned long count, void **pages, const int *nodes, int *status) {
+  (void)count, (void)pages, (void)nodes, (void)status;
+  return -1;
+}
+
+static int mbind_area(void *addr, size_t len, int mpol,
+		      unsigned long *nodemask, unsigned long maxnode, int move) {
+  (void)addr, (void)len, (void)mpol, (void)nodemask, (void)maxnode, (void)move;
+  return 0;
+}
+
+
 /* ------------------------------------------------------------
  * ULIBC_free
  * ------------------------------------------------------------ */
-void ULIBC_free(void *ptr) {
-  if ( ! ptr ) return;
-
-  struct mattr_node_t *res = delete_mattr( &__mattr_tree_root, ptr );
-  if ( !res ) return;
-  
-  if ( res->routine == ULIBC_MMAP ) {
+static void release_mattr_node(struct mattr_node_t *res) {
+  if ( res->routine == ULIBC_MMAP || res->routine == ULIBC_MMAP_FILE ||
+       res->routine == ULIBC_MMAP_SHM ) {
     munmap( res->addr, res->bytes );
   } else {
     free( res->addr );
@@ -125,22 +163,26 @@ void ULIBC_free(void *ptr) {
   free(res);
 }
 
+void ULIBC_free(void *ptr) {
+  if ( ! ptr ) return;
+
+  struct mattr_node_t *res = delete_mattr( ptr );
+  if ( !res ) return;
+  wait_async_touch(res);
+  stats_free(res);
+  
+  if ( !cache_mattr_node(res) )
+    release_mattr_node(res);
+}
+
 void ULIBC_all_free(void) {
   struct mattr_node_t *res = NULL;
-  while ( ( res = pop_mattr(&__mattr_tree_root) ) ) {
-    if ( res->routine == ULIBC_MMAP ) {
-      munmap( res->addr, res->bytes );
-    } else {
-      free( res->addr );
-    }
-
-    if ( ULIBC_verbose() > 1 ) {
-      printf("ULIBC: free ");
-      print_mattr_node( res );
-      printf("\n");
-    }
-    
-    free(res);
+  ULIBC_clear_node_alloc();
+  wait_async_touch(NULL);
+  ULIBC_trim_cache(0);
+  while ( ( res = pop_mattr() ) ) {
+    stats_free(res);
+    release_mattr_node(res);
   }
 }
 
@@ -166,9 +208,10 @@ void *NUMA_malloc(size_t size, const int onnode) {
 void *NUMA_touched_malloc(size_t size, int onnode) {
   void *p = ULIBC_malloc_bind(size, onnode);
   
-  struct mattr_node_t *res = find_mattr(&__mattr_tree_root, p);
+  struct mattr_node_t *res = find_mattr(p);
   if ( res )
     res->touched = 1;
+  put_mattr(res);
   
   return touch_seq(p, size);
 }
@@ -179,9 +222,10 @@ void ULIBC_touch_memories(size_t size[MAX_NODES], void *pool[MAX_NODES]) {
     unsigned char *addr = pool[ni.node];
     const size_t sz = size[ni.node];
     
-    struct mattr_node_t *res = find_mattr(&__mattr_tree_root, addr);
+    struct mattr_node_t *res = find_mattr(addr);
     if ( res )
       res->touched = 1;
+    put_mattr(res);
     
     if ( addr )
       touch_seq(addr, sz);
@@ -36,6 +36,12 @@ int ULIBC_bind_thread_explicit(int threadid) {
   return 1;
 }
 
+int ULIBC_bind_node(int node) {
+  (void)node;
+  if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
+  return 1;
+}
+
 int ULIBC_bind_thread(void) {
   if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
   return 1;
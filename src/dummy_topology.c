@@ -17,6 +17,7 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with ULIBC.  If not, see <http://www.gnu.org/licenses/>.
  * ---------------------------------------------------------------------- */
+#include <unistd.h>
 #include <ulibc.h>
 #include <common.h>
 
@@ -34,7 +35,7 @@ static int __num_procs;
 static int __num_nodes;
 static int __num_cores;
 static int __num_smts;
-static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0} };
+static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0,0,0} };
 
 /* initialize_topology */
 static void dummy_topology_traversal(void);
@@ -96,6 +97,23 @@ int ULIBC_get_num_smts(void) { return __num_smts; }
 size_t ULIBC_page_size(unsigned nodeidx) { return __pagesize[nodeidx]; }
 size_t ULIBC_memory_size(unsigned nodeidx) { return __memorysize[nodeidx]; }
 size_t ULIBC_align_size(void) { return __alignsize; }
+long ULIBC_get_nr_hugepages(unsigned nodeidx, size_t pagesize) {
+  (void)nodeidx, (void)pagesize;
+  return 0;
+}
+long ULIBC_get_free_hugepages(unsigned nodeidx, size_t pagesize) {
+  (void)nodeidx, (void)pagesize;
+  return 0;
+}
+size_t ULIBC_free_memory_size(unsigned nodeidx) {
+  return ULIBC_memory_size(nodeidx);
+}
+
+/* a single node */
+int ULIBC_get_node_distance(unsigned a, unsigned b) {
+  if ( MAX_NODES <= a || MAX_NODES <= b ) return -1;
+  return a == b ? 10 : 20;
+}
 
 size_t ULIBC_total_memory_size(void) {
   static size_t total = 0;
@@ -112,6 +130,41 @@ struct cpuinfo_t ULIBC_get_cpuinfo(unsigned procidx) {
   return __cpuinfo[procidx];
 }
 
+/* sysconf() reports the caches of the current processor; L1 and L2
+   caches are assumed to be private, and the others to be shared */
+struct cacheinfo_t ULIBC_get_cache_info(int level, unsigned procidx) {
+  struct cacheinfo_t c = { .level = 0, .leader = -1 };
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL4_CACHE_SIZE)
+  const int name[MAX_CACHE_LEVELS][3] = {
+    { _SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL1_DCACHE_LINESIZE, _SC_LEVEL1_DCACHE_ASSOC },
+    { _SC_LEVEL2_CACHE_SIZE,  _SC_LEVEL2_CACHE_LINESIZE,  _SC_LEVEL2_CACHE_ASSOC  },
+    { _SC_LEVEL3_CACHE_SIZE,  _SC_LEVEL3_CACHE_LINESIZE,  _SC_LEVEL3_CACHE_ASSOC  },
+    { _SC_LEVEL4_CACHE_SIZE,  _SC_LEVEL4_CACHE_LINESIZE,  _SC_LEVEL4_CACHE_ASSOC  },
+  };
+  if ( level < 1 || MAX_CACHE_LEVELS < level || ULIBC_get_num_procs() <= (int)procidx )
+    return c;
+  const long size = sysconf( name[level-1][0] );
+  if ( size <= 0 )
+    return c;
+  c.level   = level;
+  c.type    = level == 1 ? ULIBC_CACHE_DATA : ULIBC_CACHE_UNIFIED;
+  c.size    = size;
+  c.line    = MAX( sysconf( name[level-1][1] ), 0L );
+  c.ways    = MAX( sysconf( name[level-1][2] ), 0L );
+  c.leader  = level <= 2 ? (int)procidx : 0;
+  c.nshared = level <= 2 ? 1 : ULIBC_get_num_procs();
+#else
+  (void)level, (void)procidx;
+#endif
+  return c;
+}
+int ULIBC_get_cache_levels(void) {
+  int level = MAX_CACHE_LEVELS;
+  while ( level > 0 && !ULIBC_get_cache_info(level, 0).level )
+    --level;
+  return level;
+}
+
 /* dummy function for detecting CPU and Memory topology */
 static void dummy_topology_traversal(void) {
   __memorysize[0] = 0;
@@ -123,6 +176,8 @@ static void dummy_topology_traversal(void) {
       .node = 0,
       .core = i,
       .smt = 0,
+      .type = ULIBC_CORE_PERFORMANCE,
+      .capacity = CPU_CAPACITY_SCALE,
     };
   }
 }
@@ -47,6 +47,12 @@ static int get_mempol_mode(int mode) {
   switch (mode) {
   case ULIBC_MPOL_BIND:       return HWLOC_MEMBIND_BIND;
   case ULIBC_MPOL_INTERLEAVE: return HWLOC_MEMBIND_INTERLEAVE;
+  case ULIBC_MPOL_WEIGHTED_INTERLEAVE: return HWLOC_MEMBIND_INTERLEAVE;
+  case ULIBC_MPOL_CHUNK_INTERLEAVE: return HWLOC_MEMBIND_INTERLEAVE;
+  /* HWLOC_MEMBIND_BIND without HWLOC_MEMBIND_STRICT may use other nodes */
+  case ULIBC_MPOL_PREFERRED:  return HWLOC_MEMBIND_BIND;
+  case ULIBC_MPOL_PREFERRED_MANY: return HWLOC_MEMBIND_BIND;
+  case ULIBC_MPOL_LOCAL:      return HWLOC_MEMBIND_FIRSTTOUCH;
   case ULIBC_MPOL_DEFAULT:
   default:                    return HWLOC_MEMBIND_DEFAULT;
   }
@@ -69,9 +75,16 @@ static int get_mempol_mode(int mode) {
 #define USE_HWLOC_ALLOCATOR 0
 #endif
 
-void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+static void *malloc_explict_stripe(size_t size, int mpol, unsigned long *nodemask,
+				   unsigned long maxnode, int page, size_t unit) {
+  const int umpol = mpol;
   mpol = get_mempol_mode(mpol);
-   
+  
+  struct mattr_node_t *c = NULL;
+  if ( !is_striped_mpol(umpol) )
+    c = reuse_cached_mattr(size, mpol, nodemask, maxnode, page);
+  if ( c ) return c->addr;
+  
   hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
   hwloc_bitmap_zero( nodeset );
   for (unsigned long i = 0; i < maxnode; ++i) {
@@ -87,19 +100,37 @@ void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsig
   
   void *p = NULL;
   if ( USE_HWLOC_ALLOCATOR ) {
-    p = hwloc_alloc_membind_nodeset( ULIBC_get_hwloc_topology(), size, nodeset, mpol, HWLOC_MEMBIND_MIGRATE );
+    STATS_TIMED( STATS_MMAP, p = hwloc_alloc_membind_nodeset( ULIBC_get_hwloc_topology(), size, nodeset, mpol, HWLOC_MEMBIND_MIGRATE ) );
+    page = ULIBC_PAGE_DEFAULT;
   } else {
-    p = mmap(0, size, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), 0, 0);
-    hwloc_set_area_membind_nodeset( ULIBC_get_hwloc_topology(), p, size, nodeset, mpol, HWLOC_MEMBIND_MIGRATE );
+    p = mmap_page_policy(&size, &page, nodemask, maxnode);
+    int err = 0;
+    if ( p )
+      STATS_TIMED( STATS_MBIND, err = hwloc_set_area_membind_nodeset( ULIBC_get_hwloc_topology(), p, size, nodeset, mpol, HWLOC_MEMBIND_MIGRATE ) );
+    if ( err ) {
+      if ( ULIBC_verbose() )
+	printf("ULIBC: hwloc_set_area_membind_nodeset(%p, %ld, %s) failed (errno: %d), uses HWLOC_MEMBIND_DEFAULT\n",
+	       p, size, get_mempol_mode_name(mpol), errno);
+      mpol = HWLOC_MEMBIND_DEFAULT;
+    }
   }
   hwloc_bitmap_free(nodeset);
+  if ( !p ) return NULL;
   
-  struct mattr_node_t *m = insert_mattr( &__mattr_tree_root, size, p );
+  struct mattr_node_t *m = insert_mattr( size, p );
   m->touched = 0;
   m->routine = ULIBC_MMAP; /* dummy */
   m->mpol    = mpol;
+  m->page    = page;
   m->maxnode = maxnode;
   memcpy( m->nodemask, nodemask, maxnode/sizeof(unsigned long) );
+  if ( is_striped_mpol(umpol) && mpol == HWLOC_MEMBIND_INTERLEAVE &&
+       stripe_mattr_node(m, umpol, nodemask, maxnode, unit) && unit ) {
+    release_mattr_node( delete_mattr(p) );
+    return NULL;
+  }
+  stats_alloc(m, umpol);
+  async_touch_new(m);
   
   if ( ULIBC_verbose() > 1 ) {
     printf("ULIBC: allocate ");
@@ -110,14 +141,13 @@ void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsig
   return p;
 }
 
+void *ULIBC_malloc_explict_page(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode, int page) {
+  return malloc_explict_stripe(size, mpol, nodemask, maxnode, page, 0);
+}
+
 void *ULIBC_malloc_mempol(size_t size, int mpol) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  const char *descnode = getenv("ULIBC_MEMBIND");
-  if ( descnode ) {
-    make_nodemask_sscanf(descnode, MAX_NODES, nodemask);
-  } else {
-    make_nodemask_online(MAX_NODES, nodemask);
-  }
+  mpol = membind_nodemask(mpol, nodemask);
   size = ROUNDUP2M( size );
   void *p = ULIBC_malloc_explict(size, mpol, nodemask, MAX_NODES);
   return p;
@@ -125,9 +155,11 @@ void *ULIBC_malloc_mempol(size_t size, int mpol) {
 
 void *ULIBC_malloc_bind(size_t size, int node) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  SET_BITMAP( nodemask, ULIBC_get_online_nodeidx(node) );
   size = ROUNDUP2M( size );
+  const int k = spill_node(size, node);
+  SET_BITMAP( nodemask, ULIBC_get_online_nodeidx(k) );
   void *p = ULIBC_malloc_explict(size, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+  mark_spilled(p, node, k);
   return p;
 }
 
@@ -140,16 +172,53 @@ void *ULIBC_malloc_interleave(size_t size) {
 }
 
 
+static int mbind_area(void *addr, size_t len, int mpol,
+		      unsigned long *nodemask, unsigned long maxnode, int move) {
+  hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+  hwloc_bitmap_zero( nodeset );
+  for (unsigned long i = 0; i < maxnode && i < (unsigned long)ULIBC_get_num_nodes(); ++i) {
+    if ( ISSET_BITMAP( (uint64_t *)nodemask, i ) )
+      hwloc_bitmap_or( nodeset, nodeset, ULIBC_get_node_hwloc_obj(i)->nodeset );
+  }
+  int err;
+  STATS_TIMED( STATS_MBIND, err = hwloc_set_area_membind_nodeset( ULIBC_get_hwloc_topology(), addr, len, nodeset,
+								  get_mempol_mode(mpol), move ? HWLOC_MEMBIND_MIGRATE : 0 ) );
+  hwloc_bitmap_free(nodeset);
+  return err;
+}
+
+#if defined(__linux__)
+#include <syscall.h>
+extern long int syscall(long int __sysno, ...);
+static long query_page_nodes(unsigned long count, void **pages, int *status) {
+  return syscall(SYS_move_pages, 0, count, pages, NULL, status, 0);
+}
+
+static long move_page_nodes(unsigned long count, void **pages, const int *nodes, int *status) {
+  long err;
+  STATS_TIMED( STATS_MBIND, err = syscall(SYS_move_pages, 0, count, pages, nodes, status, 1 << 1 /* MPOL_MF_MOVE */) );
+  return err;
+}
+#else
+static long query_page_nodes(unsigned long count, void **pages, int *status) {
+  (void)count, (void)pages, (void)status;
+  return -1;
+}
+
+static long move_page_nodes(unsigned long count, void **pages, const int *nodes, int *status) {
+  (void)count, (void)pages, (void)nodes, (void)status;
+  return -1;
+}
+#endif
+
+
 /* ------------------------------------------------------------
  * ULIBC_free
  * ------------------------------------------------------------ */
-void ULIBC_free(void *ptr) {
-  if ( ! ptr ) return;
-
-  struct mattr_node_t *res = delete_mattr( &__mattr_tree_root, ptr );
-  if ( !res ) return;
-  
-  if ( USE_HWLOC_ALLOCATOR ) {
+static void release_mattr_node(struct mattr_node_t *res) {
+  if ( res->routine == ULIBC_MMAP_FILE || res->routine == ULIBC_MMAP_SHM ) {
+    munmap( res->addr, res->bytes );
+  } else if ( USE_HWLOC_ALLOCATOR ) {
     hwloc_free( ULIBC_get_hwloc_topology(), res->addr, res->bytes );
   } else {
     if ( res->routine == ULIBC_MMAP ) {
@@ -168,26 +237,26 @@ void ULIBC_free(void *ptr) {
   free(res);
 }
 
+void ULIBC_free(void *ptr) {
+  if ( ! ptr ) return;
+
+  struct mattr_node_t *res = delete_mattr( ptr );
+  if ( !res ) return;
+  wait_async_touch(res);
+  stats_free(res);
+  
+  if ( !cache_mattr_node(res) )
+    release_mattr_node(res);
+}
+
 void ULIBC_all_free(void) {
   struct mattr_node_t *res = NULL;
-  while ( ( res = pop_mattr(&__mattr_tree_root) ) ) {
-    if ( USE_HWLOC_ALLOCATOR ) {
-      hwloc_free( ULIBC_get_hwloc_topology(), res->addr, res->bytes );
-    } else {
-      if ( res->routine == ULIBC_MMAP ) {
-	munmap( res->addr, res->bytes );
-      } else {
-	free( res->addr );
-      }
-    }
-
-    if ( ULIBC_verbose() > 1 ) {
-      printf("ULIBC: free ");
-      print_mattr_node( res );
-      printf("\n");
-    }
-    
-    free(res);
+  ULIBC_clear_node_alloc();
+  wait_async_touch(NULL);
+  ULIBC_trim_cache(0);
+  while ( ( res = pop_mattr() ) ) {
+    stats_free(res);
+    release_mattr_node(res);
   }
 }
 
@@ -213,9 +282,10 @@ void *NUMA_malloc(size_t size, const int onnode) {
 void *NUMA_touched_malloc(size_t size, int onnode) {
   void *p = ULIBC_malloc_bind(size, onnode);
   
-  struct mattr_node_t *res = find_mattr(&__mattr_tree_root, p);
+  struct mattr_node_t *res = find_mattr(p);
   if ( res )
     res->touched = 1;
+  put_mattr(res);
   
   return touch_seq(p, size);
 }
@@ -226,9 +296,10 @@ void ULIBC_touch_memories(size_t size[MAX_NODES], void *pool[MAX_NODES]) {
     unsigned char *addr = pool[ni.node];
     const size_t sz = size[ni.node];
     
-    struct mattr_node_t *res = find_mattr(&__mattr_tree_root, addr);
+    struct mattr_node_t *res = find_mattr(addr);
     if ( res )
       res->touched = 1;
+    put_mattr(res);
     
     if ( addr )
       touch_seq(addr, sz);
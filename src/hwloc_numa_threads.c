@@ -87,6 +87,14 @@ static void bind_thread(const int id) {
     }
     break;
   }
+  case THREAD_TO_LLC: {
+    for (int u = 0; u < ULIBC_get_online_procs(); ++u) {
+      struct numainfo_t nj = ULIBC_get_numainfo(u);
+      if ( ni.llc == nj.llc )
+	hwloc_bitmap_or( cpuset, cpuset, ULIBC_get_cpu_hwloc_obj(nj.proc)->cpuset );
+    }
+    break;
+  }
   default: break;
   }
   
@@ -108,6 +116,24 @@ int ULIBC_bind_thread_explicit(int threadid) {
   return 1;
 }
 
+/* binds the calling thread to the online processors on the node-th NUMA node */
+int ULIBC_bind_node(int node) {
+  if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
+  
+  hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+  hwloc_bitmap_zero(cpuset);
+  for (int u = 0; u < ULIBC_get_online_procs(); ++u) {
+    struct numainfo_t ni = ULIBC_get_numainfo(u);
+    if ( ni.node == node )
+      hwloc_bitmap_or( cpuset, cpuset, ULIBC_get_cpu_hwloc_obj(ni.proc)->cpuset );
+  }
+  const int bound = !hwloc_bitmap_iszero(cpuset);
+  if ( bound )
+    hwloc_set_cpubind( ULIBC_get_hwloc_topology(), cpuset, HWLOC_CPUBIND_THREAD );
+  hwloc_bitmap_free(cpuset);
+  return bound;
+}
+
 int ULIBC_bind_thread(void) {
   if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
   
@@ -40,13 +40,19 @@ hwloc_obj_t ULIBC_get_cpu_hwloc_obj(int cpu) { return __cpu_obj[cpu]; }
 
 static size_t __pagesize[MAX_NODES] = {0};
 static size_t __memorysize[MAX_NODES] = {0};
+static unsigned char __distance[MAX_NODES][MAX_NODES];	/* SLIT (0: unknown) */
 static size_t __alignsize = 0;
 static int __cpuinfo_count = 0;
 static int __num_procs;
 static int __num_nodes;
 static int __num_cores;
 static int __num_smts;
-static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0} };
+static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0,0,0} };
+static struct cacheinfo_t __cacheinfo[MAX_CPUS][MAX_CACHE_LEVELS];
+static int __cache_levels = 0;
+
+static size_t __hugepagesize[MAX_NODES][4] = {{0}};
+static long __nr_hugepages[MAX_NODES][4] = {{0}};
 
 static bitmap_t hwloc_isonline_proc[MAX_CPUS/64] = {0};
 static bitmap_t hwloc_isonline_node[MAX_NODES/64] = {0};
@@ -63,6 +69,9 @@ static int __online_ncores_on_node[MAX_NODES] = { 0 };
 
 /* initialize_topology */
 static void hwloc_topology_traversal(hwloc_topology_t topology, hwloc_obj_t obj, unsigned depth);
+static void hwloc_node_distances(hwloc_topology_t topology);
+static void hwloc_cache_traversal(hwloc_obj_t obj);
+static void hwloc_cpu_kinds(hwloc_topology_t topology);
 
 int ULIBC_init_topology(void) {
   double t;
@@ -85,6 +94,9 @@ int ULIBC_init_topology(void) {
   
   PROFILED( t, hwloc_topology_traversal(__hwloc_topology, hwloc_get_root_obj(__hwloc_topology), 0) );
   __num_nodes = __online_nodes;
+  PROFILED( t, hwloc_node_distances(__hwloc_topology) );
+  PROFILED( t, hwloc_cache_traversal(hwloc_get_root_obj(__hwloc_topology)) );
+  PROFILED( t, hwloc_cpu_kinds(__hwloc_topology) );
   if ( __num_procs != __cpuinfo_count ) {
     printf("ULIBC: don't work hwloc_topology_traversal()\n");
     printf("ULIBC: # CPUs is %d, # CPUinfos is %d\n", __num_procs, __cpuinfo_count);
@@ -116,6 +128,43 @@ size_t ULIBC_page_size(unsigned nodeidx) { return __pagesize[nodeidx]; }
 size_t ULIBC_memory_size(unsigned nodeidx) { return __memorysize[nodeidx]; }
 size_t ULIBC_align_size(void) { return __alignsize; }
 
+long ULIBC_get_nr_hugepages(unsigned nodeidx, size_t pagesize) {
+  for (int i = 0; i < 4; ++i) {
+    if ( __hugepagesize[nodeidx][i] == pagesize )
+      return __nr_hugepages[nodeidx][i];
+  }
+  return 0;
+}
+/* HWLOC reports the number of pages in the pool only */
+long ULIBC_get_free_hugepages(unsigned nodeidx, size_t pagesize) {
+  return ULIBC_get_nr_hugepages(nodeidx, pagesize);
+}
+
+/* HWLOC reports the local memory only; reads MemFree on Linux */
+size_t ULIBC_free_memory_size(unsigned nodeidx) {
+  size_t kB = 0;
+#if defined(__linux__)
+  char path[PATH_MAX], line[256];
+  sprintf(path, "/sys/devices/system/node/node%u/meminfo", nodeidx);
+  FILE *fp = fopen(path, "r");
+  if ( fp ) {
+    int node;
+    while ( fgets(line, sizeof(line), fp) ) {
+      if ( sscanf(line, "Node %d MemFree: %zu kB", &node, &kB) == 2 ) break;
+    }
+    fclose(fp);
+  }
+#endif
+  return kB ? kB * 1024 : ULIBC_memory_size(nodeidx);
+}
+
+/* SLIT distance between NUMA nodes (10: local) */
+int ULIBC_get_node_distance(unsigned a, unsigned b) {
+  if ( MAX_NODES <= a || MAX_NODES <= b ) return -1;
+  if ( __distance[a][b] ) return __distance[a][b];
+  return a == b ? 10 : 20;
+}
+
 size_t ULIBC_total_memory_size(void) {
   static size_t total = 0;
   if (total == 0) {
@@ -130,10 +179,19 @@ struct cpuinfo_t ULIBC_get_cpuinfo(unsigned procidx) {
     return __cpuinfo[procidx];
   else
     return (struct cpuinfo_t){
-      .id = -1, .node = -1, .core = -1, .smt = -1,
+      .id = -1, .node = -1, .core = -1, .smt = -1, .type = -1, .capacity = -1,
     };
 }
 
+/* data or unified cache of the level on the processor */
+struct cacheinfo_t ULIBC_get_cache_info(int level, unsigned procidx) {
+  if ( level < 1 || MAX_CACHE_LEVELS < level || MAX_CPUS <= procidx ||
+       !__cacheinfo[procidx][level-1].level )
+    return (struct cacheinfo_t){ .level = 0, .leader = -1 };
+  return __cacheinfo[procidx][level-1];
+}
+int ULIBC_get_cache_levels(void) { return __cache_levels; }
+
 
 /* CPU and Memory detection using HWLOC */
 /* temporary variables for hwloc_topology_traversal() */
@@ -156,6 +214,10 @@ static void hwloc_topology_traversal(hwloc_topology_t topology, hwloc_obj_t obj,
     __memorysize[curr_node] = obj->memory.local_memory;
     for (unsigned i = 0; i < obj->memory.page_types_len; ++i) {
       __pagesize[curr_node] = obj->memory.page_types[i].size;
+      if ( i > 0 && i <= 4 ) {
+	__hugepagesize[curr_node][i-1] = obj->memory.page_types[i].size;
+	__nr_hugepages[curr_node][i-1] = obj->memory.page_types[i].count;
+      }
     }
     __node_obj[curr_node] = obj;
 
@@ -182,6 +244,8 @@ static void hwloc_topology_traversal(hwloc_topology_t topology, hwloc_obj_t obj,
       .node = curr_node,
       .core = curr_core,
       .smt = curr_smt[curr_core]++,
+      .type = ULIBC_CORE_PERFORMANCE,
+      .capacity = CPU_CAPACITY_SCALE,
     };
     __cpu_obj[proc] = obj;	/* hwloc_obj_t */
     
@@ -194,6 +258,108 @@ static void hwloc_topology_traversal(hwloc_topology_t topology, hwloc_obj_t obj,
   }
 }
 
+/* NUMA distance matrix; hwloc 1.x keeps it normalized by latency_base */
+static void set_node_distance(hwloc_obj_t a, hwloc_obj_t b, double d) {
+  if ( a && b && a->os_index < MAX_NODES && b->os_index < MAX_NODES )
+    __distance[a->os_index][b->os_index] = (unsigned char)MIN(MAX(d + 0.5, 0.0), 255.0);
+}
+
+static void hwloc_node_distances(hwloc_topology_t topology) {
+#if HWLOC_API_VERSION >= 0x00020000
+  struct hwloc_distances_s *dist = NULL;
+  unsigned nr = 1;
+  if ( hwloc_distances_get_by_type(topology, HWLOC_OBJ_NUMANODE, &nr, &dist,
+				   HWLOC_DISTANCES_KIND_MEANS_LATENCY, 0) || nr == 0 )
+    return;
+  for (unsigned i = 0; i < dist->nbobjs; ++i)
+    for (unsigned j = 0; j < dist->nbobjs; ++j)
+      set_node_distance(dist->objs[i], dist->objs[j], dist->values[i * dist->nbobjs + j]);
+  hwloc_distances_release(topology, dist);
+#else
+  const struct hwloc_distances_s *dist =
+    hwloc_get_whole_distance_matrix_by_type(topology, HWLOC_OBJ_NODE);
+  if ( !dist || !dist->latency )
+    return;
+  for (unsigned i = 0; i < dist->nbobjs; ++i)
+    for (unsigned j = 0; j < dist->nbobjs; ++j)
+      set_node_distance(hwloc_get_obj_by_type(topology, HWLOC_OBJ_NODE, i),
+			hwloc_get_obj_by_type(topology, HWLOC_OBJ_NODE, j),
+			dist->latency[i * dist->nbobjs + j] * dist->latency_base);
+#endif
+}
+
+/* caches; hwloc 1.x has a single HWLOC_OBJ_CACHE type */
+#if HWLOC_API_VERSION >= 0x00020000
+#  define IS_HWLOC_CACHE(obj) hwloc_obj_type_is_cache((obj)->type)
+#else
+#  define IS_HWLOC_CACHE(obj) ((obj)->type == HWLOC_OBJ_CACHE)
+#endif
+
+static void hwloc_cache_traversal(hwloc_obj_t obj) {
+  if ( IS_HWLOC_CACHE(obj) && obj->attr &&
+       obj->attr->cache.type != HWLOC_OBJ_CACHE_INSTRUCTION &&
+       0 < (int)obj->attr->cache.depth && obj->attr->cache.depth <= MAX_CACHE_LEVELS ) {
+    const int level = obj->attr->cache.depth;
+    const struct cacheinfo_t c = {
+      .level   = level,
+      .type    = obj->attr->cache.type == HWLOC_OBJ_CACHE_DATA ? ULIBC_CACHE_DATA : ULIBC_CACHE_UNIFIED,
+      .size    = obj->attr->cache.size,
+      .line    = obj->attr->cache.linesize,
+      .ways    = MAX(obj->attr->cache.associativity, 0),
+      .leader  = hwloc_bitmap_first(obj->cpuset),
+      .nshared = hwloc_bitmap_weight(obj->cpuset),
+    };
+    int proc;
+    hwloc_bitmap_foreach_begin(proc, obj->cpuset) {
+      if ( proc < MAX_CPUS )
+	__cacheinfo[proc][level-1] = c;
+    } hwloc_bitmap_foreach_end();
+    __cache_levels = MAX(__cache_levels, level);
+  }
+  for (unsigned i = 0; i < obj->arity; ++i) {
+    hwloc_cache_traversal(obj->children[i]);
+  }
+}
+
+/* core types of hybrid processors; hwloc 2.4 ranks CPU kinds by efficiency,
+   the most powerful last. The capacity is LinuxCapacity if available */
+static void hwloc_cpu_kinds(hwloc_topology_t topology) {
+#if HWLOC_API_VERSION >= 0x00020400
+  const int nr = hwloc_cpukinds_get_nr(topology, 0);
+  if ( nr <= 1 ) return;
+  hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+  int maxcap = 0;
+  for (int k = 0; k < nr; ++k) {
+    int efficiency = -1, proc;
+    unsigned nr_infos = 0;
+    struct hwloc_info_s *infos = NULL;
+    if ( hwloc_cpukinds_get_info(topology, k, cpuset, &efficiency, &nr_infos, &infos, 0) )
+      continue;
+    if ( efficiency < 0 ) break;	/* unknown order */
+    int capacity = CPU_CAPACITY_SCALE * (k+1) / nr;
+    for (unsigned i = 0; i < nr_infos; ++i)
+      if ( !strcmp(infos[i].name, "LinuxCapacity") && atoi(infos[i].value) > 0 )
+	capacity = atoi(infos[i].value);
+    maxcap = MAX(maxcap, capacity);
+    hwloc_bitmap_foreach_begin(proc, cpuset) {
+      if ( proc < MAX_CPUS && ISSET_BITMAP(hwloc_isonline_proc, proc) ) {
+	__cpuinfo[proc].type = ( k == nr-1 ) ? ULIBC_CORE_PERFORMANCE : ULIBC_CORE_EFFICIENCY;
+	__cpuinfo[proc].capacity = capacity;
+      }
+    } hwloc_bitmap_foreach_end();
+  }
+  hwloc_bitmap_free(cpuset);
+  
+  /* scales to CPU_CAPACITY_SCALE for the fastest CPU */
+  for (int proc = 0; maxcap > 0 && proc < MAX_CPUS; ++proc)
+    if ( ISSET_BITMAP(hwloc_isonline_proc, proc) )
+      __cpuinfo[proc].capacity =
+	(int)( (int64_t)__cpuinfo[proc].capacity * CPU_CAPACITY_SCALE / maxcap );
+#else
+  (void)topology;
+#endif
+}
+
 /* detection function */
 int is_online_proc(int proc) {
   hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
@@ -36,6 +36,7 @@ int ULIBC_init(void) {
   TOPLEVEL_PROFILED( ret |= ULIBC_init_online_topology() );
   TOPLEVEL_PROFILED( ret |= ULIBC_init_numa_mapping() );
   TOPLEVEL_PROFILED( ret |= ULIBC_init_numa_threads() );
+  TOPLEVEL_PROFILED( ret |= ULIBC_init_numa_policy() );
   TOPLEVEL_PROFILED( ret |= ULIBC_init_numa_barriers() );
   TOPLEVEL_PROFILED( ret |= ULIBC_init_barriers() );
   TOPLEVEL_PROFILED( ret |= ULIBC_init_numa_loops() );
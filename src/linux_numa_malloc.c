@@ -26,6 +26,16 @@
 #include <ulibc.h>
 #include <common.h>
 
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+#ifndef MPOL_PREFERRED_MANY
+#define MPOL_PREFERRED_MANY 5
+#endif
+#ifndef MPOL_WEIGHTED_INTERLEAVE
+#define MPOL_WEIGHTED_INTERLEAVE 6
+#endif
+
 extern long int syscall(long int __sysno, ...);
 
 long set_mempolicy(int mode, const unsigned long *nmask, unsigned long maxnode) {
@@ -37,15 +47,20 @@ int mbind(void *addr, unsigned long len, int mode,
   return syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, flags);
 }
 
+long move_pages(int pid, unsigned long count, void **pages,
+		const int *nodes, int *status, int flags) {
+  return syscall(SYS_move_pages, pid, count, pages, nodes, status, flags);
+}
+
 static const char *get_mempol_mode_name(int mode) {
   switch (mode) {
   case MPOL_DEFAULT:    return "MPOL_DEFAULT";
   case MPOL_PREFERRED:  return "MPOL_PREFERRED";
   case MPOL_BIND:       return "MPOL_BIND";
   case MPOL_INTERLEAVE: return "MPOL_INTERLEAVE";
-#ifdef MPOL_LOCAL
+  case MPOL_WEIGHTED_INTERLEAVE: return "MPOL_WEIGHTED_INTERLEAVE";
+  case MPOL_PREFERRED_MANY: return "MPOL_PREFERRED_MANY";
   case MPOL_LOCAL:      return "MPOL_LOCAL";
-#endif
   default:              return "Unknown";
   }
 }
@@ -54,6 +69,11 @@ static int get_mempol_mode(int mode) {
   switch (mode) {
   case ULIBC_MPOL_BIND:       return MPOL_BIND;
   case ULIBC_MPOL_INTERLEAVE: return MPOL_INTERLEAVE;
+  case ULIBC_MPOL_WEIGHTED_INTERLEAVE: return MPOL_INTERLEAVE;
+  case ULIBC_MPOL_CHUNK_INTERLEAVE: return MPOL_INTERLEAVE;
+  case ULIBC_MPOL_PREFERRED:  return MPOL_PREFERRED;
+  case ULIBC_MPOL_PREFERRED_MANY: return MPOL_PREFERRED_MANY;
+  case ULIBC_MPOL_LOCAL:      return MPOL_LOCAL;
   case ULIBC_MPOL_DEFAULT:
   default:                    return MPOL_DEFAULT;
   }
@@ -68,18 +88,87 @@ static int get_mempol_mode(int mode) {
 #  define ROUNDUP2M(x) ROUNDUP(x,1UL<<21)
 #endif
 
-void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+/* the kernel's weights (/sys/kernel/mm/mempolicy/weighted_interleave/nodeN)
+   are used if they are in proportion to ULIBC weights */
+static int kernel_weighted_interleave(unsigned long *nodemask, unsigned long maxnode) {
+  long ref_sys = 0, ref_w = 0;
+  for (unsigned long k = 0; k < MIN(maxnode, (unsigned long)MAX_NODES); ++k) {
+    if ( !ISSET_BITMAP( (uint64_t *)nodemask, k ) ) continue;
+    char path[PATH_MAX];
+    long sys = -1;
+    snprintf(path, sizeof(path), "/sys/kernel/mm/mempolicy/weighted_interleave/node%lu", k);
+    FILE *fp = fopen(path, "r");
+    if ( !fp ) return 0;
+    if ( fscanf(fp, "%ld", &sys) != 1 ) sys = -1;
+    fclose(fp);
+    const long w = ULIBC_get_interleave_weight(k);
+    if ( sys <= 0 ) return 0;
+    if ( ref_sys == 0 ) {
+      ref_sys = sys;
+      ref_w = w;
+    } else if ( w * ref_sys != sys * ref_w ) {
+      return 0;
+    }
+  }
+  return ref_sys > 0;
+}
+
+/* MPOL_LOCAL takes no nodes */
+static int mbind_mode(void *addr, size_t len, int mode,
+		      unsigned long *nodemask, unsigned long maxnode, unsigned flags) {
+  int err;
+  if ( mode == MPOL_LOCAL )
+    STATS_TIMED( STATS_MBIND, err = mbind(addr, len, MPOL_LOCAL, NULL, 0, flags) );
+  else
+    STATS_TIMED( STATS_MBIND, err = mbind(addr, len, mode | MPOL_F_STATIC_NODES, nodemask, maxnode, flags) );
+  return err;
+}
+
+static void *malloc_explict_stripe(size_t size, int mpol, unsigned long *nodemask,
+				   unsigned long maxnode, int page, size_t unit) {
+  const int umpol = mpol;
   mpol = get_mempol_mode(mpol);
+  if ( umpol == ULIBC_MPOL_WEIGHTED_INTERLEAVE && kernel_weighted_interleave(nodemask, maxnode) )
+    mpol = MPOL_WEIGHTED_INTERLEAVE;
+  
+  struct mattr_node_t *c = NULL;
+  if ( !is_striped_mpol(umpol) )
+    c = reuse_cached_mattr(size, mpol, nodemask, maxnode, page);
+  if ( c ) return c->addr;
   
-  void *p = mmap(0, size, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), 0, 0);
-  mbind(p, size, mpol | MPOL_F_STATIC_NODES, nodemask, maxnode, MPOL_MF_MOVE);
+  void *p = mmap_page_policy(&size, &page, nodemask, maxnode);
+  if ( !p ) return NULL;
+  int err = mbind_mode(p, size, mpol, nodemask, maxnode, MPOL_MF_MOVE);
+  if ( err && mpol == MPOL_WEIGHTED_INTERLEAVE ) {
+    mpol = MPOL_INTERLEAVE;
+    err = mbind_mode(p, size, mpol, nodemask, maxnode, MPOL_MF_MOVE);
+  }
+  if ( err && mpol == MPOL_PREFERRED_MANY ) {
+    /* before Linux 5.15; prefers the first node */
+    mpol = MPOL_PREFERRED;
+    err = mbind_mode(p, size, mpol, nodemask, maxnode, MPOL_MF_MOVE);
+  }
+  if ( err ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: mbind(%p, %ld, %s) failed (errno: %d), uses MPOL_DEFAULT\n",
+	     p, size, get_mempol_mode_name(mpol), errno);
+    mpol = MPOL_DEFAULT;
+  }
   
-  struct mattr_node_t *m = insert_mattr( &__mattr_tree_root, size, p );
+  struct mattr_node_t *m = insert_mattr( size, p );
   m->touched = 0;
   m->routine = ULIBC_MMAP;
   m->mpol    = mpol;
+  m->page    = page;
   m->maxnode = maxnode;
   memcpy( m->nodemask, nodemask, maxnode/sizeof(unsigned long) );
+  if ( is_striped_mpol(umpol) && mpol == MPOL_INTERLEAVE &&
+       stripe_mattr_node(m, umpol, nodemask, maxnode, unit) && unit ) {
+    release_mattr_node( delete_mattr(p) );
+    return NULL;
+  }
+  stats_alloc(m, umpol);
+  async_touch_new(m);
   
   if ( ULIBC_verbose() > 1 ) {
     printf("ULIBC: allocate ");
@@ -90,14 +179,13 @@ void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsig
   return p;
 }
 
+void *ULIBC_malloc_explict_page(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode, int page) {
+  return malloc_explict_stripe(size, mpol, nodemask, maxnode, page, 0);
+}
+
 void *ULIBC_malloc_mempol(size_t size, int mpol) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  const char *descnode = getenv("ULIBC_MEMBIND");
-  if ( descnode ) {
-    make_nodemask_sscanf(descnode, MAX_NODES, nodemask);
-  } else {
-    make_nodemask_online(MAX_NODES, nodemask);
-  }
+  mpol = membind_nodemask(mpol, nodemask);
   size = ROUNDUP2M( size );
   void *p = ULIBC_malloc_explict(size, mpol, nodemask, MAX_NODES);
   return p;
@@ -105,9 +193,11 @@ void *ULIBC_malloc_mempol(size_t size, int mpol) {
 
 void *ULIBC_malloc_bind(size_t size, int node) {
   unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
-  SET_BITMAP( nodemask, ULIBC_get_online_nodeidx(node) );
   size = ROUNDUP2M( size );
+  const int k = spill_node(size, node);
+  SET_BITMAP( nodemask, ULIBC_get_online_nodeidx(k) );
   void *p = ULIBC_malloc_explict(size, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+  mark_spilled(p, node, k);
   return p;
 }
 
@@ -120,16 +210,29 @@ void *ULIBC_malloc_interleave(size_t size) {
 }
 
 
+static long query_page_nodes(unsigned long count, void **pages, int *status) {
+  return move_pages(0, count, pages, NULL, status, 0);
+}
+
+static long move_page_nodes(unsigned long count, void **pages, const int *nodes, int *status) {
+  long err;
+  STATS_TIMED( STATS_MBIND, err = move_pages(0, count, pages, nodes, status, MPOL_MF_MOVE) );
+  return err;
+}
+
+static int mbind_area(void *addr, size_t len, int mpol,
+		      unsigned long *nodemask, unsigned long maxnode, int move) {
+  return mbind_mode(addr, len, get_mempol_mode(mpol),
+		    nodemask, maxnode, move ? MPOL_MF_MOVE : 0);
+}
+
+
 /* ------------------------------------------------------------
  * ULIBC_free
  * ------------------------------------------------------------ */
-void ULIBC_free(void *ptr) {
-  if ( ! ptr ) return;
-
-  struct mattr_node_t *res = delete_mattr( &__mattr_tree_root, ptr );
-  if ( !res ) return;
-  
-  if ( res->routine == ULIBC_MMAP ) {
+static void release_mattr_node(struct mattr_node_t *res) {
+  if ( res->routine == ULIBC_MMAP || res->routine == ULIBC_MMAP_FILE ||
+       res->routine == ULIBC_MMAP_SHM ) {
     munmap( res->addr, res->bytes );
   } else {
     free( res->addr );
@@ -144,22 +247,26 @@ void ULIBC_free(void *ptr) {
   free(res);
 }
 
+void ULIBC_free(void *ptr) {
+  if ( ! ptr ) return;
+
+  struct mattr_node_t *res = delete_mattr( ptr );
+  if ( !res ) return;
+  wait_async_touch(res);
+  stats_free(res);
+  
+  if ( !cache_mattr_node(res) )
+    release_mattr_node(res);
+}
+
 void ULIBC_all_free(void) {
   struct mattr_node_t *res = NULL;
-  while ( ( res = pop_mattr(&__mattr_tree_root) ) ) {
-    if ( res->routine == ULIBC_MMAP ) {
-      munmap( res->addr, res->bytes );
-    } else {
-      free( res->addr );
-    }
-
-    if ( ULIBC_verbose() > 1 ) {
-      printf("ULIBC: free ");
-      print_mattr_node( res );
-      printf("\n");
-    }
-    
-    free(res);
+  ULIBC_clear_node_alloc();
+  wait_async_touch(NULL);
+  ULIBC_trim_cache(0);
+  while ( ( res = pop_mattr() ) ) {
+    stats_free(res);
+    release_mattr_node(res);
   }
 }
 
@@ -180,9 +287,10 @@ void *NUMA_malloc(size_t size, const int onnode) {
 void *NUMA_touched_malloc(size_t size, int onnode) {
   void *p = ULIBC_malloc_bind(size, onnode);
   
-  struct mattr_node_t *res = find_mattr(&__mattr_tree_root, p);
+  struct mattr_node_t *res = find_mattr(p);
   if ( res )
     res->touched = 1;
+  put_mattr(res);
   
   return touch_seq(p, size);
 }
@@ -193,9 +301,10 @@ void ULIBC_touch_memories(size_t size[MAX_NODES], void *pool[MAX_NODES]) {
     unsigned char *addr = pool[ni.node];
     const size_t sz = size[ni.node];
     
-    struct mattr_node_t *res = find_mattr(&__mattr_tree_root, addr);
+    struct mattr_node_t *res = find_mattr(addr);
     if ( res )
       res->touched = 1;
+    put_mattr(res);
     
     if ( addr )
       touch_seq(addr, sz);
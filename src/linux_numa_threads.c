@@ -81,6 +81,14 @@ static void bind_thread(const int id) {
     }
     break;
   }
+  case THREAD_TO_LLC: {
+    for (int u = 0; u < ULIBC_get_online_procs(); ++u) {
+      struct numainfo_t nj = ULIBC_get_numainfo(u);
+      if ( ni.llc == nj.llc )
+  	CPU_SET(nj.proc, &cpuset);
+    }
+    break;
+  }
   default: break;
   }
   
@@ -101,6 +109,22 @@ int ULIBC_bind_thread_explicit(int threadid) {
   return 1;
 }
 
+/* binds the calling thread to the online processors on the node-th NUMA node */
+int ULIBC_bind_node(int node) {
+  if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
+  
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int u = 0; u < ULIBC_get_online_procs(); ++u) {
+    struct numainfo_t ni = ULIBC_get_numainfo(u);
+    if ( ni.node == node )
+      CPU_SET(ni.proc, &cpuset);
+  }
+  if ( CPU_COUNT(&cpuset) == 0 ) return 0;
+  sched_setaffinity( (pid_t)0, sizeof(cpu_set_t), &cpuset );
+  return 1;
+}
+
 int ULIBC_bind_thread(void) {
   if ( ULIBC_use_affinity() != ULIBC_AFFINITY ) return 0;
   
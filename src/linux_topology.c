@@ -19,10 +19,12 @@
  * ---------------------------------------------------------------------- */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <sched.h>
+#include <unistd.h>
 
 #include <ulibc.h>
 #include <common.h>
@@ -39,23 +41,29 @@ void ULIBC_set_version(void) {
 
 static size_t __pagesize[MAX_NODES] = { DEFAULT_PAGESIZE };
 static size_t __memorysize[MAX_NODES] = {0};
+static unsigned char __distance[MAX_NODES][MAX_NODES];	/* SLIT (0: unknown) */
 static size_t __alignsize = 0;
 static int __cpuinfo_count = 0;
 static int __num_procs;
 static int __num_nodes;
 static int __num_cores;
 static int __num_smts;
-static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0} };
+static struct cpuinfo_t __cpuinfo[MAX_CPUS] = { {0,0,0,0,0,0} };
+static struct cacheinfo_t __cacheinfo[MAX_CPUS][MAX_CACHE_LEVELS];
+static int __cache_levels = 0;
 
 #include <sys/sysinfo.h>
 #define number_of_procs() get_nprocs()
 
 static int fill_cpuinfo(struct cpuinfo_t *cpuinfo);
+static void fill_cpu_capacity(int ncpus, struct cpuinfo_t *cpuinfo);
 static int get_max_nodes(int ncpus, struct cpuinfo_t *cpuinfo);
 static int get_uniq_cores(int ncpus, struct cpuinfo_t *cpuinfo, int cores[MAX_CPUS]);
 static int make_smtid(int ncpus, struct cpuinfo_t *cpuinfo, 
 		      int nnodes, int ncores, int uniq_cores[MAX_CPUS]);
 static size_t ULIBC_get_total_ramsize(void);
+static int load_topology_cache(const char *path);
+static int save_topology_cache(const char *path);
 
 int ULIBC_init_topology(void) {
   double t;
@@ -70,25 +78,38 @@ int ULIBC_init_topology(void) {
   __num_cores = __num_procs;
   __num_smts  = __num_procs;
   for (int i = 0; i < __num_procs; ++i) {
-    __cpuinfo[i] = (struct cpuinfo_t){ .id = i, .node = 0, .core = i, .smt = 0 };
+    __cpuinfo[i] = (struct cpuinfo_t){ .id = i, .node = 0, .core = i, .smt = 0,
+				       .capacity = CPU_CAPACITY_SCALE };
   }
   
-  /* read cpuinfos from device file such as /sys/devices/system/{cpu,node}/.. */
-  PROFILED( t, __cpuinfo_count = fill_cpuinfo(__cpuinfo) );
-  if ( !(__num_procs == __cpuinfo_count) ) return 1;
-  
-  /* detect #nodes */
-  PROFILED( t, __num_nodes = get_max_nodes(__num_procs, __cpuinfo) );
-  
-  /* detect #cores */
-  int uniq_cores[MAX_CPUS];
-  PROFILED( t, __num_cores = get_uniq_cores(__num_procs, __cpuinfo, uniq_cores) );
-  __num_cores *= __num_nodes;
-
-  /* set SMT ID and detect #SMTs */
-  PROFILED( t, __num_smts = make_smtid(__num_procs, __cpuinfo,
-				       __num_nodes, __num_cores, uniq_cores) );
-  __num_smts *= __num_cores;
+  /* reuse the snapshot of a previous process on the same boot */
+  const char *cache = getenv("ULIBC_TOPOLOGY_CACHE");
+  if ( cache && !load_topology_cache(cache) ) {
+    __cpuinfo_count = __num_procs;
+  } else {
+    /* read cpuinfos from device file such as /sys/devices/system/{cpu,node}/.. */
+    PROFILED( t, __cpuinfo_count = fill_cpuinfo(__cpuinfo) );
+    if ( !(__num_procs == __cpuinfo_count) ) return 1;
+    
+    /* detect core types and capacities of hybrid processors */
+    PROFILED( t, fill_cpu_capacity(__num_procs, __cpuinfo) );
+    
+    /* detect #nodes */
+    PROFILED( t, __num_nodes = get_max_nodes(__num_procs, __cpuinfo) );
+    
+    /* detect #cores */
+    int uniq_cores[MAX_CPUS];
+    PROFILED( t, __num_cores = get_uniq_cores(__num_procs, __cpuinfo, uniq_cores) );
+    __num_cores *= __num_nodes;
+    
+    /* set SMT ID and detect #SMTs */
+    PROFILED( t, __num_smts = make_smtid(__num_procs, __cpuinfo,
+					 __num_nodes, __num_cores, uniq_cores) );
+    __num_smts *= __num_cores;
+    
+    if ( cache && save_topology_cache(cache) && ULIBC_verbose() )
+      printf("ULIBC: cannot save the topology to %s\n", cache);
+  }
   
   if ( __num_procs != __cpuinfo_count ) {
     printf("ULIBC: cannot read /sys/devices/system/{cpu,node}/..\n");
@@ -149,6 +170,49 @@ size_t ULIBC_page_size(unsigned nodeidx) { return __pagesize[nodeidx]; }
 size_t ULIBC_memory_size(unsigned nodeidx) { return __memorysize[nodeidx]; }
 size_t ULIBC_align_size(void) { return __alignsize; }
 
+/* hugetlbfs pages on each node, e.g. /sys/devices/system/node/node0/hugepages/hugepages-2048kB/ */
+static long parse_node_hugepages(unsigned nodeidx, size_t pagesize, const char *name) {
+  char path[PATH_MAX];
+  sprintf(path, "/sys/devices/system/node/node%u/hugepages/hugepages-%lukB/%s",
+	  nodeidx, (unsigned long)(pagesize >> 10), name);
+  long x = 0;
+  FILE *fp = fopen(path, "r");
+  if (fp) {
+    if ( fscanf(fp, "%ld", &x) != 1 ) x = 0;
+    fclose(fp);
+  }
+  return x;
+}
+long ULIBC_get_nr_hugepages(unsigned nodeidx, size_t pagesize) {
+  return parse_node_hugepages(nodeidx, pagesize, "nr_hugepages");
+}
+long ULIBC_get_free_hugepages(unsigned nodeidx, size_t pagesize) {
+  return parse_node_hugepages(nodeidx, pagesize, "free_hugepages");
+}
+
+/* current MemFree of /sys/devices/system/node/node0/meminfo */
+size_t ULIBC_free_memory_size(unsigned nodeidx) {
+  char path[PATH_MAX], line[256];
+  sprintf(path, "/sys/devices/system/node/node%u/meminfo", nodeidx);
+  size_t kB = 0;
+  FILE *fp = fopen(path, "r");
+  if ( !fp ) return ULIBC_memory_size(nodeidx);
+  while ( fgets(line, sizeof(line), fp) ) {
+    /* Node 0 MemFree:        120312344 kB */
+    int node;
+    if ( sscanf(line, "Node %d MemFree: %zu kB", &node, &kB) == 2 ) break;
+  }
+  fclose(fp);
+  return kB * 1024;
+}
+
+
+/* SLIT distance between NUMA nodes (10: local) */
+int ULIBC_get_node_distance(unsigned a, unsigned b) {
+  if ( MAX_NODES <= a || MAX_NODES <= b ) return -1;
+  if ( __distance[a][b] ) return __distance[a][b];
+  return a == b ? 10 : 20;
+}
 
 size_t ULIBC_total_memory_size(void) {
   static size_t total = 0;
@@ -166,6 +230,15 @@ struct cpuinfo_t ULIBC_get_cpuinfo(unsigned procidx) {
   return __cpuinfo[procidx];
 }
 
+/* data or unified cache of the level on the processor */
+struct cacheinfo_t ULIBC_get_cache_info(int level, unsigned procidx) {
+  if ( level < 1 || MAX_CACHE_LEVELS < level || MAX_CPUS <= procidx ||
+       !__cacheinfo[procidx][level-1].level )
+    return (struct cacheinfo_t){ .level = 0, .leader = -1 };
+  return __cacheinfo[procidx][level-1];
+}
+int ULIBC_get_cache_levels(void) { return __cache_levels; }
+
 
 static int parse_cpufile(const char *file) {
   int x = -1;
@@ -191,6 +264,120 @@ static size_t parse_node_meminfo(const char *file) {
 }
 
 
+
+/* reads the first line of dir/name */
+static char *parse_cache_attr(const char *dir, const char *name, char *buf, int len) {
+  char path[PATH_MAX];
+  if ( snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path) ) return NULL;
+  FILE *fp = fopen(path, "r");
+  if (!fp) return NULL;
+  char *s = fgets(buf, len, fp);
+  fclose(fp);
+  return s;
+}
+
+/* e.g. "48K" */
+static size_t parse_cache_size(const char *s) {
+  char *end;
+  size_t x = strtoul(s, &end, 10);
+  switch (*end) {
+  case 'K': return x << 10;
+  case 'M': return x << 20;
+  case 'G': return x << 30;
+  default:  return x;
+  }
+}
+
+/* #processors in a list such as "0-3,8"; *first is the lowest one */
+/* CPU list such as "0-3,8" into set (if not NULL); returns #CPUs */
+static int parse_cpulist(const char *s, bitmap_t *set, int *first) {
+  int count = 0;
+  *first = -1;
+  for (;;) {
+    char *end;
+    const long a = strtol(s, &end, 10);
+    long b = a;
+    if (end == s) break;
+    if (*end == '-') {
+      s = end+1;
+      b = strtol(s, &end, 10);
+    }
+    if (*first < 0 || a < *first) *first = a;
+    count += b - a + 1;
+    for (long i = MAX(a, 0); set && i <= b && i < MAX_CPUS; ++i)
+      SET_BITMAP(set, i);
+    if (*end != ',') break;
+    s = end+1;
+  }
+  return count;
+}
+
+static int parse_cache_cpus(const char *s, int *first) {
+  return parse_cpulist(s, NULL, first);
+}
+
+/* ids of the online NUMA nodes in ascending order, from
+   /sys/devices/system/node/online (e.g. "0-1,3"); returns #nodes, or 0 */
+static int parse_online_nodes(int *ids) {
+  char buf[LINE_MAX];
+  bitmap_t set[MAX_CPUS/64] = {0};
+  int first, n = 0;
+  FILE *fp = fopen("/sys/devices/system/node/online", "r");
+  if ( !fp ) return 0;
+  if ( fgets(buf, sizeof(buf), fp) )
+    parse_cpulist(buf, set, &first);
+  fclose(fp);
+  for (int k = 0; k < MAX_NODES; ++k)
+    if ( ISSET_BITMAP(set, k) ) ids[n++] = k;
+  return n;
+}
+
+/* e.g. /sys/devices/system/node/node0/distance: "10 21 31 21", whose j-th
+   value is the distance to the j-th online node (ids[j]) */
+static void parse_node_distance(const char *file, int nodeid, const int *ids, int nids) {
+  FILE *fp = fopen(file, "r");
+  if (fp) {
+    int d;
+    for (int j = 0; j < MAX_NODES && fscanf(fp, "%d", &d) == 1; ++j) {
+      const int to = nids ? ( j < nids ? ids[j] : -1 ) : j;
+      if ( 0 <= to )
+	__distance[nodeid][to] = (unsigned char)MIN(MAX(d, 0), 255);
+    }
+    fclose(fp);
+  }
+}
+
+/* e.g. /sys/devices/system/cpu/cpu0/cache/index2/{level,type,size,...} */
+static void parse_cpu_caches(int cpuid, const char *dirpath) {
+  char dir[PATH_MAX], buf[LINE_MAX];
+  for (int k = 0; ; ++k) {
+    if ( snprintf(dir, sizeof(dir), "%s/index%d", dirpath, k) >= (int)sizeof(dir) ) break;
+    if ( !parse_cache_attr(dir, "level", buf, sizeof(buf)) ) break;
+    const int level = atoi(buf);
+    if ( level < 1 || MAX_CACHE_LEVELS < level ) continue;
+    if ( !parse_cache_attr(dir, "type", buf, sizeof(buf)) || !strncmp(buf, "Instruction", 11) ) continue;
+    
+    struct cacheinfo_t *c = &__cacheinfo[cpuid][level-1];
+    c->level = level;
+    c->type = strncmp(buf, "Data", 4) ? ULIBC_CACHE_UNIFIED : ULIBC_CACHE_DATA;
+    if ( parse_cache_attr(dir, "size", buf, sizeof(buf)) )
+      c->size = parse_cache_size(buf);
+    if ( parse_cache_attr(dir, "coherency_line_size", buf, sizeof(buf)) )
+      c->line = atoi(buf);
+    if ( parse_cache_attr(dir, "ways_of_associativity", buf, sizeof(buf)) )
+      c->ways = atoi(buf);
+    c->nshared = 0;
+    if ( parse_cache_attr(dir, "shared_cpu_list", buf, sizeof(buf)) )
+      c->nshared = parse_cache_cpus(buf, &c->leader);
+    if ( c->nshared <= 0 ) {
+      c->leader = cpuid;
+      c->nshared = 1;
+    }
+    __cache_levels = MAX(__cache_levels, level);
+  }
+}
+
+
 static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
   char path[PATH_MAX], dirpath[PATH_MAX];
   DIR *dp = NULL, *ldp = NULL;
@@ -207,7 +394,7 @@ static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
       /* scan cpu(core) id */
       cpuid = -1;
       sscanf(dir->d_name, "cpu%d", &cpuid);
-      if (cpuid < 0 || MAX_CPUS < cpuid) continue;
+      if (cpuid < 0 || MAX_CPUS <= cpuid) continue;
     
       /* read core_id */
       sprintf(path, "%s/%s/topology/core_id", dirpath, dir->d_name);
@@ -217,11 +404,17 @@ static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
 	cpuinfo[cpuid].core = coreid;
 	++num_cpus;
       }
+      
+      /* read caches */
+      if ( snprintf(path, sizeof(path), "%s/%s/cache", dirpath, dir->d_name) < (int)sizeof(path) )
+	parse_cpu_caches(cpuid, path);
     }
     closedir(dp);
   }
   
   /* open node files */
+  int online[MAX_NODES];
+  const int nonline = parse_online_nodes(online);
   strcpy(dirpath, "/sys/devices/system/node");
   dp = opendir(dirpath);
   if (!dp) {
@@ -231,7 +424,7 @@ static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
       /* scan node(socket) id */
       nodeid = -1;
       sscanf(dir->d_name, "node%d", &nodeid);
-      if (nodeid < 0 || MAX_NODES < nodeid) continue;
+      if (nodeid < 0 || MAX_NODES <= nodeid) continue;
       
       /* parse node ramsize */
       sprintf(path, "%s/%s/meminfo", dirpath, dir->d_name);
@@ -239,6 +432,10 @@ static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
       __memorysize[nodeid] = kB * 1024;
       /* printf("%s -> %ld (%f GB)\n", path, kB, (double)kB/1024/1024); */
       
+      /* parse node distances */
+      if ( snprintf(path, sizeof(path), "%s/%s/distance", dirpath, dir->d_name) < (int)sizeof(path) )
+	parse_node_distance(path, nodeid, online, nonline);
+      
       /* read cpu(core) id */
       sprintf(path, "%s/%s", dirpath, dir->d_name);
       ldp = opendir(path);
@@ -263,6 +460,51 @@ static int fill_cpuinfo(struct cpuinfo_t *cpuinfo) {
   return num_cpus;
 }
 
+/* capacities from cpu_capacity (arm64, x86 hybrid) or ACPI CPPC highest_perf,
+   scaled to CPU_CAPACITY_SCALE for the fastest CPU. Intel hybrid processors
+   list their E-cores in /sys/devices/cpu_atom/cpus; otherwise CPUs below 3/4
+   of the fastest one are efficiency cores */
+static void fill_cpu_capacity(int ncpus, struct cpuinfo_t *cpuinfo) {
+  const char *files[] = { "cpu_capacity", "acpi_cppc/highest_perf", NULL };
+  char path[PATH_MAX], buf[LINE_MAX];
+  int maxcap = 0;
+  for (int f = 0; files[f] && maxcap == 0; ++f) {
+    for (int i = 0; i < ncpus; ++i) {
+      int cap = -1;
+      if ( snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s",
+		    cpuinfo[i].id, files[f]) < (int)sizeof(path) )
+	cap = parse_cpufile(path);
+      if ( cap <= 0 ) {
+	maxcap = 0;
+	break;
+      }
+      cpuinfo[i].capacity = cap;
+      maxcap = MAX(maxcap, cap);
+    }
+  }
+  for (int i = 0; i < ncpus; ++i) {
+    if ( maxcap > 0 )
+      cpuinfo[i].capacity = (int)( (int64_t)cpuinfo[i].capacity * CPU_CAPACITY_SCALE / maxcap );
+    else
+      cpuinfo[i].capacity = CPU_CAPACITY_SCALE;
+  }
+  
+  bitmap_t atom[MAX_CPUS/64] = {0};
+  int first, hybrid = 0;
+  FILE *fp = fopen("/sys/devices/cpu_atom/cpus", "r");
+  if ( fp ) {
+    if ( fgets(buf, LINE_MAX, fp) )
+      hybrid = parse_cpulist(buf, atom, &first) > 0;
+    fclose(fp);
+  }
+  for (int i = 0; i < ncpus; ++i) {
+    int efficient = 4 * cpuinfo[i].capacity < 3 * CPU_CAPACITY_SCALE;
+    if ( hybrid )
+      efficient = ISSET_BITMAP(atom, cpuinfo[i].id);
+    cpuinfo[i].type = efficient ? ULIBC_CORE_EFFICIENCY : ULIBC_CORE_PERFORMANCE;
+  }
+}
+
 static int get_max_nodes(int ncpus, struct cpuinfo_t *cpuinfo) {
   int nodes = 0;
   for (int i = 0; i < ncpus; ++i)
@@ -312,6 +554,128 @@ static int make_smtid(int ncpus, struct cpuinfo_t *cpuinfo,
 }
 
 
+/* ------------------------------------------------------------
+ * topology cache
+ *   ULIBC_TOPOLOGY_CACHE=path keeps the parsed sysfs topology in a
+ *   binary file keyed by the boot id and a hash of the online CPU
+ *   list, so that short-lived processes skip fill_cpuinfo(). A file
+ *   of another boot, CPU list, or build is ignored and replaced.
+ *   The process affinity (online processors) is not cached.
+ * ------------------------------------------------------------ */
+#define TOPOLOGY_CACHE_MAGIC "ULIBC-topology"
+
+struct topology_cache_t {
+  char magic[16];
+  char boot_id[64];
+  uint64_t cpuhash;
+  uint32_t layout;		/* sizes of cpuinfo_t and cacheinfo_t */
+  int num_procs, num_nodes, num_cores, num_smts, cache_levels;
+  /* followed by cpuinfo[num_procs], cacheinfo[num_procs][MAX_CACHE_LEVELS],
+     memorysize[num_nodes], and distance[num_nodes][num_nodes] */
+};
+
+static void make_topology_key(struct topology_cache_t *key) {
+  memset(key, 0, sizeof(struct topology_cache_t));
+  strcpy(key->magic, TOPOLOGY_CACHE_MAGIC);
+  key->layout = (uint32_t)( sizeof(struct cpuinfo_t) << 16 | sizeof(struct cacheinfo_t) );
+  key->num_procs = __num_procs;
+  
+  FILE *fp = fopen("/proc/sys/kernel/random/boot_id", "r");
+  if ( fp ) {
+    if ( !fgets(key->boot_id, sizeof(key->boot_id), fp) )
+      key->boot_id[0] = '\0';
+    fclose(fp);
+  }
+  
+  /* FNV-1a of the online CPU list */
+  uint64_t h = 0xcbf29ce484222325ULL;
+  fp = fopen("/sys/devices/system/cpu/online", "r");
+  if ( fp ) {
+    int c;
+    while ( (c = fgetc(fp)) != EOF )
+      h = (h ^ (unsigned char)c) * 0x100000001b3ULL;
+    fclose(fp);
+  }
+  key->cpuhash = h;
+}
+
+static int load_topology_cache(const char *path) {
+  struct topology_cache_t key, hdr;
+  make_topology_key(&key);
+  if ( !key.boot_id[0] ) return -1;
+  
+  FILE *fp = fopen(path, "rb");
+  if ( !fp ) return -1;
+  int ok = fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+    !strcmp(hdr.magic, key.magic) && !strcmp(hdr.boot_id, key.boot_id) &&
+    hdr.cpuhash == key.cpuhash && hdr.layout == key.layout &&
+    hdr.num_procs == key.num_procs &&
+    0 < hdr.num_nodes && hdr.num_nodes <= MAX_NODES &&
+    0 <= hdr.cache_levels && hdr.cache_levels <= MAX_CACHE_LEVELS;
+  const size_t n = ok ? (size_t)hdr.num_procs : 0, k = ok ? (size_t)hdr.num_nodes : 0;
+  ok = ok &&
+    fread(__cpuinfo, sizeof(struct cpuinfo_t), n, fp) == n &&
+    fread(__cacheinfo, sizeof(struct cacheinfo_t) * MAX_CACHE_LEVELS, n, fp) == n &&
+    fread(__memorysize, sizeof(size_t), k, fp) == k;
+  for (size_t i = 0; ok && i < k; ++i)
+    ok = fread(__distance[i], 1, k, fp) == k;
+  fclose(fp);
+  
+  if ( !ok ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: %s is not a topology of this boot\n", path);
+    /* restores the defaults for fill_cpuinfo() */
+    for (int i = 0; i < __num_procs; ++i) {
+      __cpuinfo[i] = (struct cpuinfo_t){ .id = i, .node = 0, .core = i, .smt = 0,
+					 .capacity = CPU_CAPACITY_SCALE };
+    }
+    memset(__cacheinfo, 0, sizeof(__cacheinfo));
+    memset(__memorysize, 0, sizeof(__memorysize));
+    memset(__distance, 0, sizeof(__distance));
+    return -1;
+  }
+  
+  __num_nodes = hdr.num_nodes;
+  __num_cores = hdr.num_cores;
+  __num_smts  = hdr.num_smts;
+  __cache_levels = hdr.cache_levels;
+  if ( ULIBC_verbose() )
+    printf("ULIBC: loaded the topology of %d CPUs from %s\n", __num_procs, path);
+  return 0;
+}
+
+/* writes to a temporary file, which replaces path atomically */
+static int save_topology_cache(const char *path) {
+  struct topology_cache_t hdr;
+  make_topology_key(&hdr);
+  if ( !hdr.boot_id[0] ) return -1;
+  hdr.num_nodes = __num_nodes;
+  hdr.num_cores = __num_cores;
+  hdr.num_smts  = __num_smts;
+  hdr.cache_levels = __cache_levels;
+  
+  char tmp[PATH_MAX];
+  if ( snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp) )
+    return -1;
+  FILE *fp = fopen(tmp, "wb");
+  if ( !fp ) return -1;
+  const size_t n = __num_procs, k = __num_nodes;
+  int ok =
+    fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+    fwrite(__cpuinfo, sizeof(struct cpuinfo_t), n, fp) == n &&
+    fwrite(__cacheinfo, sizeof(struct cacheinfo_t) * MAX_CACHE_LEVELS, n, fp) == n &&
+    fwrite(__memorysize, sizeof(size_t), k, fp) == k;
+  for (size_t i = 0; ok && i < k; ++i)
+    ok = fwrite(__distance[i], 1, k, fp) == k;
+  ok = !fclose(fp) && ok;
+  if ( !ok || rename(tmp, path) ) {
+    unlink(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+
 /* detection function */
 int is_online_proc(int proc) {
   cpu_set_t cpuset;
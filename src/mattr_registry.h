@@ -0,0 +1,326 @@
+#ifndef MATTR_REGISTRY_H
+#define MATTR_REGISTRY_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/* ------------------------------------------------------------
+ * mattr registry
+ *   Allocation attributes are kept in MATTR_NSHARDS shards chosen by a
+ *   hash of the allocated address, each protected by its own lock, so
+ *   that threads allocating and releasing memory in parallel regions
+ *   rarely contend. Each shard keeps its entries in an array sorted by
+ *   address: find_mattr() is a binary search in one shard, and
+ *   find_mattr_range() resolves an interior pointer by taking the
+ *   nearest entry below it over all shards, one shard lock at a time.
+ *   No lock covers all shards.
+ *
+ *   Entries returned by find_mattr(), find_mattr_range() and
+ *   snapshot_mattr() are pinned, and the caller releases them by
+ *   put_mattr() or put_mattr_list(). delete_mattr() and pop_mattr()
+ *   unlink an entry and wait until it is unpinned, so that it is never
+ *   released under a concurrent reader.
+ * ------------------------------------------------------------ */
+#ifndef MATTR_NSHARDS
+#define MATTR_NSHARDS 64
+#endif
+#ifndef MATTR_INIT_ENTRIES
+#define MATTR_INIT_ENTRIES 16
+#endif
+#define MATTR_MAX_STRIPE 64
+#define MATTR_DYING (1 << 30)		/* added to refs when unlinked */
+
+enum mattr_mem_type_t {
+  ULIBC_UNKNOWN,
+  ULIBC_MALLOC,
+  ULIBC_POSIX_MEMALIGN,
+  ULIBC_MMAP,
+  ULIBC_MMAP_FILE,
+  ULIBC_MMAP_SHM,
+  ULIBC_NROUTINES,
+};
+
+struct mattr_node_t {
+  /* key */
+  void *addr;
+
+  /* attributes */
+  size_t bytes;
+  int touched;
+  int touching;				/* #queued asynchronous touch pieces */
+  int routine;
+  int umpol;				/* ULIBC_MPOL_* for statistics */
+  size_t *node_bytes;			/* bytes per NUMA node for statistics */
+
+  /* for mmap */
+  int mpol;
+  int page;
+  unsigned long maxnode;
+  unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8];
+  int reqnode;				/* requested NUMA node if spilled, or -1 */
+
+  /* for striped interleave */
+  size_t unit;				/* bytes per stripe unit (0: not striped) */
+  int nstripe;				/* #units per round */
+  unsigned char stripe[MATTR_MAX_STRIPE]; /* NUMA node of each unit */
+
+  /* list link (mapping cache) and pins */
+  struct mattr_node_t *next;
+  int refs;				/* #pins (+MATTR_DYING if unlinked) */
+};
+
+static struct mattr_shard_t {
+  pthread_mutex_t lock;
+  size_t count;
+  size_t capacity;
+  struct mattr_node_t **node;		/* sorted by address */
+} __mattr_shard[MATTR_NSHARDS];
+
+static pthread_once_t __mattr_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t __mattr_pin_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __mattr_unpinned = PTHREAD_COND_INITIALIZER;
+
+static const char *routine_name(int routine) {
+  const char *name[] = {
+    "unknown",
+    "malloc",
+    "posix_memalign",
+    "mmap",
+    "mmap_file",
+    "mmap_shm",
+    NULL
+  };
+  if ( 0 < routine && routine < ULIBC_NROUTINES )
+    return name[routine];
+  else
+    return name[0];
+}
+
+static void init_mattr_shards(void) {
+  for (int s = 0; s < MATTR_NSHARDS; ++s) {
+    pthread_mutex_init( &__mattr_shard[s].lock, NULL );
+    __mattr_shard[s].count = 0;
+    __mattr_shard[s].capacity = 0;
+    __mattr_shard[s].node = NULL;
+  }
+}
+
+static uint64_t mattr_hash(const void *addr) {
+  return ((uint64_t)(uintptr_t)addr >> 12) * 0x9E3779B97F4A7C15ULL;
+}
+
+static struct mattr_shard_t *mattr_shard(const void *addr) {
+  pthread_once( &__mattr_once, init_mattr_shards );
+  return &__mattr_shard[ (mattr_hash(addr) >> 58) % MATTR_NSHARDS ];
+}
+
+/* requires sh->lock; #entries of sh whose address is at most addr */
+static size_t mattr_upper(const struct mattr_shard_t *sh, const void *addr) {
+  size_t lo = 0, hi = sh->count;
+  while ( lo < hi ) {
+    const size_t mid = (lo + hi) / 2;
+    if ( (const unsigned char *)sh->node[mid]->addr <= (const unsigned char *)addr )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* requires sh->lock; returns 0, or -1 if sh cannot grow */
+static int grow_mattr_shard(struct mattr_shard_t *sh) {
+  if ( sh->count < sh->capacity ) return 0;
+  const size_t capacity = sh->capacity ? 2 * sh->capacity : MATTR_INIT_ENTRIES;
+  struct mattr_node_t **node = realloc( sh->node, sizeof(struct mattr_node_t *) * capacity );
+  if ( !node ) return -1;
+  sh->node = node;
+  sh->capacity = capacity;
+  return 0;
+}
+
+
+/* --------------------
+ * pins
+ * -------------------- */
+/* requires a lock under which m is reachable */
+static struct mattr_node_t *pin_mattr(struct mattr_node_t *m) {
+  if ( m ) __atomic_add_fetch( &m->refs, 1, __ATOMIC_SEQ_CST );
+  return m;
+}
+
+static void put_mattr(struct mattr_node_t *m) {
+  if ( !m ) return;
+  /* m may be released as soon as the last pin of an unlinked entry is dropped */
+  if ( __atomic_sub_fetch( &m->refs, 1, __ATOMIC_SEQ_CST ) == MATTR_DYING ) {
+    pthread_mutex_lock( &__mattr_pin_lock );
+    pthread_cond_broadcast( &__mattr_unpinned );
+    pthread_mutex_unlock( &__mattr_pin_lock );
+  }
+}
+
+static void put_mattr_list(struct mattr_node_t **list, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    put_mattr( list[i] );
+  free(list);
+}
+
+/* m has been unlinked; waits until nobody pins it */
+static void unpin_wait_mattr(struct mattr_node_t *m) {
+  if ( __atomic_add_fetch( &m->refs, MATTR_DYING, __ATOMIC_SEQ_CST ) == MATTR_DYING )
+    return;
+  pthread_mutex_lock( &__mattr_pin_lock );
+  while ( __atomic_load_n( &m->refs, __ATOMIC_SEQ_CST ) != MATTR_DYING )
+    pthread_cond_wait( &__mattr_unpinned, &__mattr_pin_lock );
+  pthread_mutex_unlock( &__mattr_pin_lock );
+}
+
+
+/* --------------------
+ * insert/find/delete
+ * -------------------- */
+/* requires sh->lock */
+static struct mattr_node_t *remove_mattr_at(struct mattr_shard_t *sh, size_t pos) {
+  struct mattr_node_t *m = sh->node[pos];
+  memmove( &sh->node[pos], &sh->node[pos+1], sizeof(struct mattr_node_t *) * (sh->count - pos - 1) );
+  --sh->count;
+  return m;
+}
+
+static struct mattr_node_t *insert_mattr(size_t bytes, void *addr) {
+  struct mattr_node_t *m = calloc( 1, sizeof(struct mattr_node_t) );
+  if ( !m ) return NULL;
+  m->bytes = bytes;
+  m->addr = addr;
+  m->reqnode = -1;
+
+  struct mattr_shard_t *sh = mattr_shard(addr);
+  pthread_mutex_lock( &sh->lock );
+  const size_t pos = mattr_upper(sh, addr);
+  if ( ( pos > 0 && sh->node[pos-1]->addr == addr ) || grow_mattr_shard(sh) ) {
+    pthread_mutex_unlock( &sh->lock );
+    free(m);
+    return NULL;
+  }
+  memmove( &sh->node[pos+1], &sh->node[pos], sizeof(struct mattr_node_t *) * (sh->count - pos) );
+  sh->node[pos] = m;
+  ++sh->count;
+  pthread_mutex_unlock( &sh->lock );
+  return m;
+}
+
+/* the entry at addr, pinned */
+static struct mattr_node_t *find_mattr(void *addr) {
+  struct mattr_shard_t *sh = mattr_shard(addr);
+  struct mattr_node_t *m = NULL;
+  pthread_mutex_lock( &sh->lock );
+  const size_t pos = mattr_upper(sh, addr);
+  if ( pos > 0 && sh->node[pos-1]->addr == addr )
+    m = pin_mattr( sh->node[pos-1] );
+  pthread_mutex_unlock( &sh->lock );
+  return m;
+}
+
+/* the entry that contains addr, pinned; the nearest entry below addr
+   over all shards, since entries never overlap */
+static struct mattr_node_t *find_mattr_range(void *addr) {
+  pthread_once( &__mattr_once, init_mattr_shards );
+  struct mattr_node_t *res = NULL;
+  for (int s = 0; s < MATTR_NSHARDS; ++s) {
+    struct mattr_shard_t *sh = &__mattr_shard[s];
+    struct mattr_node_t *m = NULL;
+    pthread_mutex_lock( &sh->lock );
+    const size_t pos = mattr_upper(sh, addr);
+    if ( pos > 0 ) {
+      m = sh->node[pos-1];
+      if ( (const unsigned char *)addr < (const unsigned char *)m->addr + m->bytes &&
+	   ( !res || (unsigned char *)res->addr < (unsigned char *)m->addr ) )
+	pin_mattr(m);
+      else
+	m = NULL;
+    }
+    pthread_mutex_unlock( &sh->lock );
+    if ( m ) {
+      put_mattr(res);
+      res = m;
+    }
+  }
+  return res;
+}
+
+static struct mattr_node_t *delete_mattr(void *addr) {
+  struct mattr_shard_t *sh = mattr_shard(addr);
+  struct mattr_node_t *m = NULL;
+  pthread_mutex_lock( &sh->lock );
+  const size_t pos = mattr_upper(sh, addr);
+  if ( pos > 0 && sh->node[pos-1]->addr == addr )
+    m = remove_mattr_at(sh, pos-1);
+  pthread_mutex_unlock( &sh->lock );
+  if ( m )
+    unpin_wait_mattr(m);
+  return m;
+}
+
+static struct mattr_node_t *pop_mattr(void) {
+  pthread_once( &__mattr_once, init_mattr_shards );
+  for (int s = 0; s < MATTR_NSHARDS; ++s) {
+    struct mattr_shard_t *sh = &__mattr_shard[s];
+    struct mattr_node_t *m = NULL;
+    pthread_mutex_lock( &sh->lock );
+    if ( sh->count > 0 )
+      m = remove_mattr_at(sh, sh->count - 1);
+    pthread_mutex_unlock( &sh->lock );
+    if ( m ) {
+      unpin_wait_mattr(m);
+      return m;
+    }
+  }
+  return NULL;
+}
+
+
+/* --------------------
+ * snapshot
+ * -------------------- */
+static int mattr_addr_cmp(const void *a, const void *b) {
+  const unsigned char *x = (*(struct mattr_node_t * const *)a)->addr;
+  const unsigned char *y = (*(struct mattr_node_t * const *)b)->addr;
+  return ( x > y ) - ( x < y );
+}
+
+/* returns all entries sorted by address, pinned; the caller releases
+   them by put_mattr_list() */
+static struct mattr_node_t **snapshot_mattr(size_t *count) {
+  pthread_once( &__mattr_once, init_mattr_shards );
+  size_t n = 0, capacity = 64;
+  struct mattr_node_t **list = malloc( sizeof(struct mattr_node_t *) * capacity );
+  for (int s = 0; list && s < MATTR_NSHARDS; ++s) {
+    struct mattr_shard_t *sh = &__mattr_shard[s];
+    pthread_mutex_lock( &sh->lock );
+    if ( n + sh->count + 1 > capacity ) {
+      capacity = 2 * ( n + sh->count + 1 );
+      struct mattr_node_t **grown = realloc( list, sizeof(struct mattr_node_t *) * capacity );
+      if ( !grown ) {
+	pthread_mutex_unlock( &sh->lock );
+	break;
+      }
+      list = grown;
+    }
+    for (size_t i = 0; i < sh->count; ++i)
+      list[n++] = pin_mattr( sh->node[i] );
+    pthread_mutex_unlock( &sh->lock );
+  }
+  if ( list )
+    qsort( list, n, sizeof(struct mattr_node_t *), mattr_addr_cmp );
+  *count = n;
+  return list;
+}
+
+#endif /* MATTR_REGISTRY_H */
@@ -30,6 +30,7 @@
 #endif
 
 static pthread_barrier_t __numa_barrier[MAX_NODES];
+static pthread_barrier_t __llc_barrier[MAX_CPUS];
 
 int ULIBC_init_numa_barriers(void) {
   if ( ULIBC_verbose() ) {
@@ -43,11 +44,23 @@ int ULIBC_init_numa_barriers(void) {
   for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
     pthread_barrier_init( &__numa_barrier[k], NULL, ULIBC_get_online_cores(k) );
   }
+  for (int l = 0; l < ULIBC_get_online_llcs(); ++l) {
+    pthread_barrier_init( &__llc_barrier[l], NULL, ULIBC_get_online_llc_cores(l) );
+  }
   
   return 0;
 }
 
+/* the pthread barriers are not allocated from the slab */
+void ULIBC_clear_numa_barriers(void) {
+}
+
 void ULIBC_node_barrier(void) {
   const int node = ULIBC_get_numainfo( ULIBC_get_thread_num() ).node;
   pthread_barrier_wait( &__numa_barrier[node] );
 }
+
+void ULIBC_llc_barrier(void) {
+  const int llc = ULIBC_get_numainfo( ULIBC_get_thread_num() ).llc;
+  pthread_barrier_wait( &__llc_barrier[llc] );
+}
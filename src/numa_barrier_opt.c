@@ -19,6 +19,7 @@
  * ---------------------------------------------------------------------- */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <ulibc.h>
@@ -50,10 +51,10 @@ static struct NUMA_barrier_t {
   int rounds;
   volatile int sense[MAX_NUMA_LOCALS];
   volatile struct round_struct RS[MAX_NUMA_LOCALS][MAX_NUMA_LOCALS_SQRT];
-} *__barrier[MAX_NODES];
+} *__barrier[MAX_NODES], *__llc_barrier[MAX_CPUS];
 
 
-static void init_local_tournament_barrier(int node);
+static void init_local_tournament_barrier(struct NUMA_barrier_t *nodeNB, int lnp);
 
 int ULIBC_init_numa_barriers(void) {
   if (ULIBC_verbose())
@@ -63,10 +64,21 @@ int ULIBC_init_numa_barriers(void) {
   for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
     if ( !__barrier[k] ) {
       ++wakeup_count;
-      size_t sz = ROUNDUP(sizeof(struct NUMA_barrier_t), ULIBC_align_size());
-      __barrier[k] = NUMA_touched_malloc(sz, k);
+      __barrier[k] = ULIBC_node_alloc(sizeof(struct NUMA_barrier_t), k);
+      if ( !__barrier[k] ) return 1;
+      memset(__barrier[k], 0x00, sizeof(struct NUMA_barrier_t));
     }
-    init_local_tournament_barrier(k);
+    init_local_tournament_barrier(__barrier[k], ULIBC_get_online_cores(k));
+  }
+  for (int l = 0; l < ULIBC_get_online_llcs(); ++l) {
+    if ( !__llc_barrier[l] ) {
+      const int node = ULIBC_get_numainfo( ULIBC_get_online_llc_thread(l, 0) ).node;
+      ++wakeup_count;
+      __llc_barrier[l] = ULIBC_node_alloc(sizeof(struct NUMA_barrier_t), node);
+      if ( !__llc_barrier[l] ) return 1;
+      memset(__llc_barrier[l], 0x00, sizeof(struct NUMA_barrier_t));
+    }
+    init_local_tournament_barrier(__llc_barrier[l], ULIBC_get_online_llc_cores(l));
   }
   
   if (ULIBC_verbose())
@@ -74,11 +86,16 @@ int ULIBC_init_numa_barriers(void) {
   return 0;
 }
 
+/* the barriers are freed with the slab; ULIBC_init_numa_barriers() allocates them again */
+void ULIBC_clear_numa_barriers(void) {
+  for (int k = 0; k < MAX_NODES; ++k)
+    __barrier[k] = NULL;
+  for (int l = 0; l < MAX_CPUS; ++l)
+    __llc_barrier[l] = NULL;
+}
+
 
-static void init_local_tournament_barrier(int node) {
-  /* allocation */
-  struct NUMA_barrier_t *nodeNB = (struct NUMA_barrier_t *)__barrier[node];
-  const int lnp = ULIBC_get_online_cores(node);
+static void init_local_tournament_barrier(struct NUMA_barrier_t *nodeNB, int lnp) {
   nodeNB->rounds = ceil( log(lnp)/log(2) );
   if ( nodeNB->rounds == 0 ) nodeNB->rounds = 1;
   
@@ -132,27 +149,23 @@ static void init_local_tournament_barrier(int node) {
 }
 
 
-void ULIBC_node_barrier(void) {
-  const struct numainfo_t ni = ULIBC_get_current_numainfo();
-  struct NUMA_barrier_t *nodeNB = __barrier[ni.node];
-  /* assert( nodeNB ); */
-  
-  volatile int *sense = & ( nodeNB->sense[ni.core] );
+static void tournament_barrier(struct NUMA_barrier_t *nodeNB, int core) {
+  volatile int *sense = & ( nodeNB->sense[core] );
   int round = 0;
   while (1) {
-    if ( nodeNB->RS[ni.core][round].rule == TR_LOSER ) {
-      *(nodeNB->RS[ni.core][round]).opponent = *sense;
-      while ( nodeNB->RS[ni.core][round].flag != *sense );
+    if ( nodeNB->RS[core][round].rule == TR_LOSER ) {
+      *(nodeNB->RS[core][round]).opponent = *sense;
+      while ( nodeNB->RS[core][round].flag != *sense );
       break;
     }
     
-    if ( nodeNB->RS[ni.core][round].rule == TR_WINNER ) {
-      while ( nodeNB->RS[ni.core][round].flag != *sense );
+    if ( nodeNB->RS[core][round].rule == TR_WINNER ) {
+      while ( nodeNB->RS[core][round].flag != *sense );
     }
 
-    if ( nodeNB->RS[ni.core][round].rule == TR_CHAMPION ){
-      while ( nodeNB->RS[ni.core][round].flag != *sense );
-      *( nodeNB->RS[ni.core][round] ).opponent = *sense;
+    if ( nodeNB->RS[core][round].rule == TR_CHAMPION ){
+      while ( nodeNB->RS[core][round].flag != *sense );
+      *( nodeNB->RS[core][round] ).opponent = *sense;
       break;
     }
 
@@ -162,10 +175,21 @@ void ULIBC_node_barrier(void) {
   //wake up
   while (1) {
     if ( round > 0 ) round = round - 1;
-    if ( nodeNB->RS[ni.core][round].rule == TR_WINNER )
-      *( nodeNB->RS[ni.core][round] ).opponent = *sense;
-    if ( nodeNB->RS[ni.core][round].rule == TR_DROPOUT ) break;
+    if ( nodeNB->RS[core][round].rule == TR_WINNER )
+      *( nodeNB->RS[core][round] ).opponent = *sense;
+    if ( nodeNB->RS[core][round].rule == TR_DROPOUT ) break;
   }
 
   *sense = !*sense;
 }
+
+void ULIBC_node_barrier(void) {
+  const struct numainfo_t ni = ULIBC_get_current_numainfo();
+  /* assert( __barrier[ni.node] ); */
+  tournament_barrier(__barrier[ni.node], ni.core);
+}
+
+void ULIBC_llc_barrier(void) {
+  const struct numainfo_t ni = ULIBC_get_current_numainfo();
+  tournament_barrier(__llc_barrier[ni.llc], ni.llc_core);
+}
@@ -23,20 +23,61 @@
 
 static int64_t *__counter[MAX_NODES] = { NULL };
 static int64_t *__loopend[MAX_NODES] = { NULL };
+static int64_t *__llc_counter[MAX_CPUS] = { NULL };
+static int64_t *__llc_loopend[MAX_CPUS] = { NULL };
+
+/* capacities of threads, and their prefix sums in (node, core) order */
+static int __thread_capacity[MAX_CPUS];
+static int64_t __thread_capacity_base[MAX_CPUS];
+static int64_t __node_capacity_base[MAX_NODES+1];
 
 int ULIBC_init_numa_loops(void) {
-  size_t size[MAX_CPUS];
-  void *pool[MAX_CPUS];
+  const size_t line = CACHELINE_SIZE / sizeof(int64_t);
   for (int i = 0; i < ULIBC_get_online_nodes(); ++i) {
-    size[i] = ROUNDUP(sizeof(int64_t), ULIBC_align_size());
-    pool[i] = NUMA_malloc(size[i], i);
-    __counter[i] = &((int64_t *)pool[i])[00];
-    __loopend[i] = &((int64_t *)pool[i])[64];
+    if ( !__counter[i] ) {
+      int64_t *pool = ULIBC_node_alloc(2 * CACHELINE_SIZE, i);
+      if ( !pool ) return 1;
+      __counter[i] = &pool[0];
+      __loopend[i] = &pool[line];
+    }
+    *__counter[i] = 0;
+    *__loopend[i] = 0;
+  }
+  for (int l = 0; l < ULIBC_get_online_llcs(); ++l) {
+    if ( !__llc_counter[l] ) {
+      const int node = ULIBC_get_numainfo( ULIBC_get_online_llc_thread(l, 0) ).node;
+      int64_t *pool = ULIBC_node_alloc(2 * CACHELINE_SIZE, node);
+      if ( !pool ) return 1;
+      __llc_counter[l] = &pool[0];
+      __llc_loopend[l] = &pool[line];
+    }
+    *__llc_counter[l] = 0;
+    *__llc_loopend[l] = 0;
+  }
+  
+  int64_t base = 0;
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    __node_capacity_base[k] = base;
+    for (int c = 0; c < ULIBC_get_online_cores(k); ++c) {
+      const int tid = ULIBC_get_online_thread(k, c);
+      const int cap = ULIBC_get_cpuinfo( ULIBC_get_numainfo(tid).proc ).capacity;
+      __thread_capacity[tid] = MAX(cap, 1);
+      __thread_capacity_base[tid] = base;
+      base += __thread_capacity[tid];
+    }
   }
-  ULIBC_touch_memories(size,pool);
+  __node_capacity_base[ ULIBC_get_online_nodes() ] = base;
   return 0;
 }
 
+/* the counters are freed with the slab; ULIBC_init_numa_loops() allocates them again */
+void ULIBC_clear_numa_loops(void) {
+  for (int i = 0; i < MAX_NODES; ++i)
+    __counter[i] = __loopend[i] = NULL;
+  for (int l = 0; l < MAX_CPUS; ++l)
+    __llc_counter[l] = __llc_loopend[l] = NULL;
+}
+
 void ULIBC_clear_numa_loop(int64_t loopstart, int64_t loopend) {
   const int id = ULIBC_get_thread_num();
   const int node = ULIBC_get_numainfo(id).node;
@@ -47,8 +88,16 @@ void ULIBC_clear_numa_loop(int64_t loopstart, int64_t loopend) {
   }
 }
 
+/* slower cores take smaller chunks, so that they finish with the others */
+static int64_t capacity_chunk(int tid, int64_t chunk) {
+  const int cap = __thread_capacity[tid];
+  return ( cap > 0 ) ? MAX(chunk * cap / CPU_CAPACITY_SCALE, 1) : chunk;
+}
+
 int ULIBC_numa_loop(int64_t chunk, int64_t *start, int64_t *end) {
-  int node = ULIBC_get_numainfo( ULIBC_get_thread_num() ).node;
+  const struct numainfo_t ni = ULIBC_get_numainfo( ULIBC_get_thread_num() );
+  const int node = ni.node;
+  chunk = capacity_chunk(ni.id, chunk);
   const int64_t t = add_and_fetch_int64(__counter[node], chunk);
   const int64_t term = *__loopend[node];
   if (t - chunk > term) {
@@ -59,3 +108,54 @@ int ULIBC_numa_loop(int64_t chunk, int64_t *start, int64_t *end) {
     return 0;
   }
 }
+
+/* the same loop shared by the threads of an LLC */
+void ULIBC_clear_llc_loop(int64_t loopstart, int64_t loopend) {
+  const struct numainfo_t ni = ULIBC_get_numainfo( ULIBC_get_thread_num() );
+  if (ni.llc_core == 0) {
+    *__llc_counter[ni.llc] = loopstart;
+    *__llc_loopend[ni.llc] = loopend;
+  }
+}
+
+int ULIBC_llc_loop(int64_t chunk, int64_t *start, int64_t *end) {
+  const struct numainfo_t ni = ULIBC_get_numainfo( ULIBC_get_thread_num() );
+  const int llc = ni.llc;
+  chunk = capacity_chunk(ni.id, chunk);
+  const int64_t t = add_and_fetch_int64(__llc_counter[llc], chunk);
+  const int64_t term = *__llc_loopend[llc];
+  if (t - chunk > term) {
+    return 1;
+  } else {
+    *start = t - chunk;
+    *end = t < term ? t : term;
+    return 0;
+  }
+}
+
+/* --------------------
+ * capacity-weighted ranges
+ *   split [off, off+len) in proportion to the capacities of threads,
+ *   so that efficiency cores get smaller static ranges than
+ *   performance cores. They are equal-sized on homogeneous systems.
+ * -------------------- */
+/* floor(len * part / whole) without overflow */
+static int64_t weighted_split(int64_t len, int64_t whole, int64_t part) {
+  return (len / whole) * part + (len % whole) * part / whole;
+}
+
+/* [ls, le) of the node-th online NUMA node */
+void ULIBC_numa_range(int64_t len, int64_t off, int node, int64_t *ls, int64_t *le) {
+  const int64_t whole = __node_capacity_base[ ULIBC_get_online_nodes() ];
+  *ls = off + weighted_split(len, whole, __node_capacity_base[node]);
+  *le = off + weighted_split(len, whole, __node_capacity_base[node+1]);
+}
+
+/* [ls, le) of the thread tid in the range of its NUMA node */
+void ULIBC_thread_range(int64_t len, int64_t off, int tid, int64_t *ls, int64_t *le) {
+  const int node = ULIBC_get_numainfo(tid).node;
+  const int64_t whole = __node_capacity_base[node+1] - __node_capacity_base[node];
+  const int64_t part = __thread_capacity_base[tid] - __node_capacity_base[node];
+  *ls = off + weighted_split(len, whole, part);
+  *le = off + weighted_split(len, whole, part + __thread_capacity[tid]);
+}
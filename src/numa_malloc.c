@@ -1,260 +1,2365 @@
 #include <inttypes.h>
+#include <limits.h>
 #include <pthread.h>
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* ------------------------------------------------------------
+ * mattr registry
+ * ------------------------------------------------------------ */
+#include "mattr_registry.h"
+
+/* ------------------------------------------------------------
+ * memory policy
+ * ------------------------------------------------------------ */
+static int __membind_mpol = -1;	/* policy prefix of ULIBC_MEMBIND */
+
+const char *ULIBC_get_mempol_name(int mpol) {
+  switch (mpol) {
+  case ULIBC_MPOL_DEFAULT:             return "default";
+  case ULIBC_MPOL_BIND:                return "bind";
+  case ULIBC_MPOL_INTERLEAVE:          return "interleave";
+  case ULIBC_MPOL_WEIGHTED_INTERLEAVE: return "weighted_interleave";
+  case ULIBC_MPOL_CHUNK_INTERLEAVE:    return "chunk_interleave";
+  case ULIBC_MPOL_PREFERRED:           return "preferred";
+  case ULIBC_MPOL_PREFERRED_MANY:      return "preferred_many";
+  case ULIBC_MPOL_LOCAL:               return "local";
+  default:                             return "unknown";
+  }
+}
+
+/* ULIBC_MEMBIND=[policy:]nodelist; returns the node list */
+static const char *parse_membind_policy(const char *s, int *mpol) {
+  const char *colon = strchr(s, ':');
+  if ( !colon || !isalpha((unsigned char)s[0]) ) return s;
+  *mpol = ULIBC_MPOL_MAX;
+  for (int i = 0; i < ULIBC_MPOL_MAX; ++i) {
+    const char *name = ULIBC_get_mempol_name(i);
+    if ( strlen(name) == (size_t)(colon - s) && !strncmp(s, name, colon - s) ) *mpol = i;
+  }
+  return colon + 1;
+}
+
+/* nodemask and policy of ULIBC_malloc_mempol() */
+static int membind_nodemask(int mpol, unsigned long *nodemask) {
+  const char *descnode = getenv("ULIBC_MEMBIND");
+  if ( descnode ) {
+    int envmpol = -1;
+    descnode = parse_membind_policy(descnode, &envmpol);
+    if ( 0 <= envmpol && envmpol < ULIBC_MPOL_MAX ) mpol = envmpol;
+  }
+  if ( descnode && *descnode ) {
+    make_nodemask_sscanf(descnode, MAX_NODES, nodemask);
+  } else {
+    make_nodemask_online(MAX_NODES, nodemask);
+  }
+  return mpol;
+}
+
+
+/* ------------------------------------------------------------
+ * page policy
+ * ------------------------------------------------------------ */
+static int __page_policy = ULIBC_PAGE_DEFAULT;
+
+const char *ULIBC_get_page_name(int page) {
+  switch (page) {
+  case ULIBC_PAGE_DEFAULT: return "default";
+  case ULIBC_PAGE_BASE:    return "base";
+  case ULIBC_PAGE_THP:     return "thp";
+  case ULIBC_PAGE_HUGE_2M: return "2m";
+  case ULIBC_PAGE_HUGE_1G: return "1g";
+  default:                 return "unknown";
+  }
+}
+
+int ULIBC_get_page_policy(void) { return __page_policy; }
+void ULIBC_set_page_policy(int page) {
+  if ( 0 <= page && page < ULIBC_PAGE_MAX )
+    __page_policy = page;
+}
+
+/* ------------------------------------------------------------
+ * touch policy
+ * ------------------------------------------------------------ */
+static int __touch_policy = ULIBC_TOUCH_STRIDE;
+
+const char *ULIBC_get_touch_name(int touch) {
+  switch (touch) {
+  case ULIBC_TOUCH_STRIDE:   return "stride";
+  case ULIBC_TOUCH_POPULATE: return "populate";
+  default:                   return "unknown";
+  }
+}
+
+int ULIBC_get_touch_policy(void) { return __touch_policy; }
+void ULIBC_set_touch_policy(int touch) {
+  if ( 0 <= touch && touch < ULIBC_TOUCH_MAX )
+    __touch_policy = touch;
+}
+
+/* ------------------------------------------------------------
+ * interleave weights
+ * ------------------------------------------------------------ */
+static int __weights_given = 0;
+static int __weights[MAX_NODES];
+
+int ULIBC_get_interleave_weight(int node) {
+  if ( node < 0 || MAX_NODES <= node ) return 0;
+  return __weights_given ? __weights[node] : 1;
+}
+
+/* weights[k] is the weight of the k-th NUMA node; NULL resets them */
+void ULIBC_set_interleave_weights(const int *weights, int nnodes) {
+  for (int k = 0; k < MAX_NODES; ++k)
+    __weights[k] = ( weights && k < nnodes ) ? MAX(weights[k], 0) : 1;
+  __weights_given = ( weights != NULL );
+}
+
+/* chunk size of ULIBC_MPOL_CHUNK_INTERLEAVE */
+#ifndef DEFAULT_INTERLEAVE_CHUNK
+#define DEFAULT_INTERLEAVE_CHUNK (1UL << 20)
+#endif
+static size_t __interleave_chunk = DEFAULT_INTERLEAVE_CHUNK;
+
+size_t ULIBC_get_interleave_chunk(void) {
+  return __interleave_chunk;
+}
+
+void ULIBC_set_interleave_chunk(size_t chunk) {
+  __interleave_chunk = chunk ? chunk : DEFAULT_INTERLEAVE_CHUNK;
+}
+
+static void parse_interleave_weights(const char *s) {
+  int weights[MAX_NODES];
+  for (int k = 0; k < MAX_NODES; ++k)
+    weights[k] = 1;
+  char *string = strdup(s), *save = NULL;
+  for (char *tok = strtok_r(string, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+    int node, w;
+    if ( sscanf(tok, "%d:%d", &node, &w) != 2 || node < 0 || MAX_NODES <= node || w < 0 ) {
+      printf("Unknown node weight '%s' in '%s'.\n"
+	     "    ULIBC_MEMBIND_WEIGHTS is a list of 'node:weight', e.g. 0:3,1:1.\n", tok, s);
+      exit(1);
+    }
+    weights[node] = w;
+  }
+  free(string);
+  ULIBC_set_interleave_weights(weights, MAX_NODES);
+}
 
 /* ------------------------------------------------------------
- * mattr_tree
+ * allocation statistics
+ *   Live counters are updated by stats_alloc() and stats_free() for
+ *   all allocations, per NUMA node, per ULIBC policy and per routine,
+ *   with __atomic operations instead of a lock. Each allocation keeps
+ *   its bytes per node in m->node_bytes: stripes are counted by their
+ *   units, interleaved pages by the node weights, preferred pages on
+ *   the first node, bound pages evenly, and first-touch pages on the
+ *   node of the allocating thread. stats_place() replaces the estimate
+ *   by the resident pages once the allocation is touched.
  * ------------------------------------------------------------ */
-#include "mattr_tsearch.h"
-static void *__mattr_tree_root = NULL;
+struct alloc_counter_t {
+  size_t bytes, peak, count, nallocs, nfrees;
+};
+
+enum { STATS_MMAP, STATS_MBIND, STATS_TOUCH, STATS_NTIMES };
+
+static struct alloc_counter_t __stats_total;
+static struct alloc_counter_t __stats_node[MAX_NODES];
+static struct alloc_counter_t __stats_mpol[ULIBC_MPOL_MAX];
+static struct alloc_counter_t __stats_routine[ULIBC_NROUTINES];
+static uint64_t __stats_nsecs[STATS_NTIMES];
+static double __stats_start = 0.0;
+
+#define STATS_TIMED(kind, X) do {		\
+    const double __t = get_msecs();		\
+    X;						\
+    stats_time(kind, get_msecs() - __t);	\
+  } while (0)
+
+static int touch_thread_node(int tid);
+
+static void stats_time(int kind, double msecs) {
+  __atomic_add_fetch( &__stats_nsecs[kind], (uint64_t)(msecs * 1e6), __ATOMIC_RELAXED );
+}
+
+static void add_bytes(struct alloc_counter_t *c, size_t bytes) {
+  const size_t now = __atomic_add_fetch( &c->bytes, bytes, __ATOMIC_RELAXED );
+  size_t peak = __atomic_load_n( &c->peak, __ATOMIC_RELAXED );
+  while ( peak < now &&
+	  !__atomic_compare_exchange_n( &c->peak, &peak, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+    ;
+}
+
+static void count_alloc(struct alloc_counter_t *c, size_t bytes) {
+  add_bytes( c, bytes );
+  __atomic_add_fetch( &c->count, 1, __ATOMIC_RELAXED );
+  __atomic_add_fetch( &c->nallocs, 1, __ATOMIC_RELAXED );
+}
+
+static void count_free(struct alloc_counter_t *c, size_t bytes) {
+  __atomic_sub_fetch( &c->bytes, bytes, __ATOMIC_RELAXED );
+  __atomic_sub_fetch( &c->count, 1, __ATOMIC_RELAXED );
+  __atomic_add_fetch( &c->nfrees, 1, __ATOMIC_RELAXED );
+}
+
+/* expected bytes of m per node; ULIBC_get_num_nodes() entries, or NULL */
+static size_t *estimate_nodes(const struct mattr_node_t *m) {
+  const int nnodes = ULIBC_get_num_nodes();
+  size_t *nb = calloc( nnodes, sizeof(size_t) );
+  if ( !nb ) return NULL;
+  
+  if ( m->unit && m->nstripe ) {
+    const size_t nunits = m->bytes / m->unit, rest = m->bytes % m->unit;
+    for (int s = 0; s < m->nstripe; ++s)
+      nb[ m->stripe[s] ] += ( nunits / m->nstripe + ( (size_t)s < nunits % m->nstripe ) ) * m->unit;
+    if ( rest )
+      nb[ m->stripe[ nunits % m->nstripe ] ] += rest;
+    return nb;
+  }
+  
+  const int first_touch = ( m->mpol == get_mempol_mode(ULIBC_MPOL_DEFAULT) ||
+			    m->mpol == get_mempol_mode(ULIBC_MPOL_LOCAL) );
+  const int local = touch_thread_node( ULIBC_get_thread_num() );
+  long w[MAX_NODES], total = 0;
+  for (int k = 0; k < nnodes; ++k) {
+    w[k] = 0;
+    if ( (unsigned long)k < m->maxnode && ISSET_BITMAP( (uint64_t *)m->nodemask, k ) ) {
+      w[k] = ( m->umpol == ULIBC_MPOL_WEIGHTED_INTERLEAVE ) ? ULIBC_get_interleave_weight(k) : 1;
+      if ( m->umpol == ULIBC_MPOL_PREFERRED && total > 0 ) w[k] = 0;
+    }
+    total += w[k];
+  }
+  if ( first_touch || total == 0 ) {
+    nb[ ( 0 <= local && local < nnodes ) ? local : 0 ] = m->bytes;
+    return nb;
+  }
+  size_t rest = m->bytes;
+  int last = 0;
+  for (int k = 0; k < nnodes; ++k) {
+    if ( !w[k] ) continue;
+    nb[k] = (size_t)( (double)m->bytes * w[k] / total );
+    rest -= nb[k];
+    last = k;
+  }
+  nb[last] += rest;
+  return nb;
+}
+
+/* moves the node counters from the bytes per node in from to those in to */
+static void move_nodes(const size_t *from, const size_t *to) {
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    const size_t a = from ? from[k] : 0, b = to ? to[k] : 0;
+    if ( a == b ) continue;
+    if ( !b )
+      count_free( &__stats_node[k], a );
+    else if ( !a )
+      count_alloc( &__stats_node[k], b );
+    else if ( a < b )
+      add_bytes( &__stats_node[k], b - a );
+    else
+      __atomic_sub_fetch( &__stats_node[k].bytes, a - b, __ATOMIC_RELAXED );
+  }
+}
+
+/* replaces the bytes per node of m by nb */
+static void stats_renode(struct mattr_node_t *m, size_t *nb) {
+  size_t *old = __atomic_exchange_n( &m->node_bytes, nb, __ATOMIC_ACQ_REL );
+  move_nodes(old, nb);
+  free(old);
+}
+
+/* attributes m by its resident pages; keeps the estimate if they are unknown */
+static void stats_place(struct mattr_node_t *m) {
+  const int nnodes = ULIBC_get_num_nodes();
+  size_t *nb = calloc( nnodes, sizeof(size_t) );
+  const size_t resident = nb ? ULIBC_query_placement(m->addr, m->bytes, nb) : 0;
+  if ( !resident ) {
+    free(nb);
+    return;
+  }
+  size_t rest = m->bytes;
+  int last = 0;
+  for (int k = 0; k < nnodes; ++k) {
+    if ( !nb[k] ) continue;
+    nb[k] = (size_t)( (double)m->bytes * nb[k] / resident );
+    rest -= nb[k];
+    last = k;
+  }
+  nb[last] += rest;
+  stats_renode(m, nb);
+}
+
+static void stats_alloc(struct mattr_node_t *m, int umpol) {
+  m->umpol = umpol;
+  count_alloc( &__stats_total, m->bytes );
+  if ( 0 <= umpol && umpol < ULIBC_MPOL_MAX )
+    count_alloc( &__stats_mpol[umpol], m->bytes );
+  if ( 0 <= m->routine && m->routine < ULIBC_NROUTINES )
+    count_alloc( &__stats_routine[m->routine], m->bytes );
+  stats_renode(m, estimate_nodes(m));
+}
+
+static void stats_free(struct mattr_node_t *m) {
+  count_free( &__stats_total, m->bytes );
+  if ( 0 <= m->umpol && m->umpol < ULIBC_MPOL_MAX )
+    count_free( &__stats_mpol[m->umpol], m->bytes );
+  if ( 0 <= m->routine && m->routine < ULIBC_NROUTINES )
+    count_free( &__stats_routine[m->routine], m->bytes );
+  stats_renode(m, NULL);
+}
+
+/* moves the policy and node counters of m, whose policy has been changed to umpol */
+static void stats_rebind(struct mattr_node_t *m, int umpol) {
+  if ( 0 <= m->umpol && m->umpol < ULIBC_MPOL_MAX )
+    __atomic_sub_fetch( &__stats_mpol[m->umpol].bytes, m->bytes, __ATOMIC_RELAXED );
+  m->umpol = umpol;
+  if ( 0 <= umpol && umpol < ULIBC_MPOL_MAX )
+    add_bytes( &__stats_mpol[umpol], m->bytes );
+  stats_renode(m, estimate_nodes(m));
+  if ( m->touched )
+    stats_place(m);
+}
+
+int ULIBC_get_alloc_stats(int kind, int index, struct ulibc_alloc_stats_t *stats) {
+  const struct alloc_counter_t *c = NULL;
+  switch (kind) {
+  case ULIBC_STATS_TOTAL:   c = &__stats_total; break;
+  case ULIBC_STATS_NODE:    if ( 0 <= index && index < MAX_NODES )       c = &__stats_node[index]; break;
+  case ULIBC_STATS_MPOL:    if ( 0 <= index && index < ULIBC_MPOL_MAX )  c = &__stats_mpol[index]; break;
+  case ULIBC_STATS_ROUTINE: if ( 0 <= index && index < ULIBC_NROUTINES ) c = &__stats_routine[index]; break;
+  }
+  if ( !c || !stats ) return -1;
+  
+  const double elapsed = ( get_msecs() - __stats_start ) * 1e-3;
+  memset( stats, 0x00, sizeof(*stats) );
+  stats->bytes       = __atomic_load_n( &c->bytes,   __ATOMIC_RELAXED );
+  stats->peak_bytes  = __atomic_load_n( &c->peak,    __ATOMIC_RELAXED );
+  stats->count       = __atomic_load_n( &c->count,   __ATOMIC_RELAXED );
+  stats->nallocs     = __atomic_load_n( &c->nallocs, __ATOMIC_RELAXED );
+  stats->nfrees      = __atomic_load_n( &c->nfrees,  __ATOMIC_RELAXED );
+  stats->alloc_rate  = elapsed > 0 ? stats->nallocs / elapsed : 0.0;
+  stats->free_rate   = elapsed > 0 ? stats->nfrees / elapsed : 0.0;
+  if ( kind == ULIBC_STATS_TOTAL ) {
+    stats->mmap_msecs  = __atomic_load_n( &__stats_nsecs[STATS_MMAP],  __ATOMIC_RELAXED ) * 1e-6;
+    stats->mbind_msecs = __atomic_load_n( &__stats_nsecs[STATS_MBIND], __ATOMIC_RELAXED ) * 1e-6;
+    stats->touch_msecs = __atomic_load_n( &__stats_nsecs[STATS_TOUCH], __ATOMIC_RELAXED ) * 1e-6;
+  }
+  return 0;
+}
+
+static void print_alloc_counter(FILE *fp, const char *name, int kind, int index, const char *sep) {
+  struct ulibc_alloc_stats_t st;
+  ULIBC_get_alloc_stats(kind, index, &st);
+  fprintf(fp, "    \"%s\": { \"bytes\": %zu, \"peak_bytes\": %zu, \"count\": %zu, "
+	  "\"nallocs\": %zu, \"nfrees\": %zu, \"alloc_rate\": %.3f, \"free_rate\": %.3f }%s\n",
+	  name, st.bytes, st.peak_bytes, st.count, st.nallocs, st.nfrees,
+	  st.alloc_rate, st.free_rate, sep);
+}
+
+/* JSON; lists the nodes, policies and routines having allocations */
+void ULIBC_print_alloc_stats(FILE *fp) {
+  struct ulibc_alloc_stats_t st;
+  ULIBC_get_alloc_stats(ULIBC_STATS_TOTAL, 0, &st);
+  char name[32];
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"elapsed_secs\": %.6f,\n", ( get_msecs() - __stats_start ) * 1e-3);
+  fprintf(fp, "  \"msecs\": { \"mmap\": %.3f, \"mbind\": %.3f, \"touch\": %.3f },\n",
+	  st.mmap_msecs, st.mbind_msecs, st.touch_msecs);
+  fprintf(fp, "  \"total\": { \"bytes\": %zu, \"peak_bytes\": %zu, \"count\": %zu, "
+	  "\"nallocs\": %zu, \"nfrees\": %zu, \"alloc_rate\": %.3f, \"free_rate\": %.3f },\n",
+	  st.bytes, st.peak_bytes, st.count, st.nallocs, st.nfrees, st.alloc_rate, st.free_rate);
+  
+  int last = -1;
+  fprintf(fp, "  \"nodes\": {\n");
+  for (int k = 0; k < MAX_NODES; ++k)
+    if ( __stats_node[k].nallocs ) last = k;
+  for (int k = 0; k <= last; ++k) {
+    if ( !__stats_node[k].nallocs ) continue;
+    sprintf(name, "%d", k);
+    print_alloc_counter(fp, name, ULIBC_STATS_NODE, k, k < last ? "," : "");
+  }
+  fprintf(fp, "  },\n");
+  
+  last = -1;
+  fprintf(fp, "  \"policies\": {\n");
+  for (int k = 0; k < ULIBC_MPOL_MAX; ++k)
+    if ( __stats_mpol[k].nallocs ) last = k;
+  for (int k = 0; k <= last; ++k) {
+    if ( !__stats_mpol[k].nallocs ) continue;
+    print_alloc_counter(fp, ULIBC_get_mempol_name(k), ULIBC_STATS_MPOL, k, k < last ? "," : "");
+  }
+  fprintf(fp, "  },\n");
+  
+  last = -1;
+  fprintf(fp, "  \"routines\": {\n");
+  for (int k = 0; k < ULIBC_NROUTINES; ++k)
+    if ( __stats_routine[k].nallocs ) last = k;
+  for (int k = 0; k <= last; ++k) {
+    if ( !__stats_routine[k].nallocs ) continue;
+    print_alloc_counter(fp, routine_name(k), ULIBC_STATS_ROUTINE, k, k < last ? "," : "");
+  }
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n");
+}
+
+static void dump_alloc_stats(void) {
+  const char *path = getenv("ULIBC_STATS_JSON");
+  if ( !path || !*path ) return;
+  const int to_stdout = !strcmp(path, "stdout") || !strcmp(path, "-");
+  FILE *fp = to_stdout ? stdout : fopen(path, "w");
+  if ( !fp ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot open %s (errno: %d)\n", path, errno);
+    return;
+  }
+  ULIBC_print_alloc_stats(fp);
+  if ( !to_stdout ) fclose(fp);
+}
+
+
+int ULIBC_init_numa_policy(void) {
+  __stats_start = get_msecs();
+  
+  const char *membind_env = getenv("ULIBC_MEMBIND");
+  if ( membind_env ) {
+    parse_membind_policy(membind_env, &__membind_mpol);
+    if ( __membind_mpol == ULIBC_MPOL_MAX ) {
+      printf("Unknown memory policy in '%s'.\n"
+	     "    ULIBC supports 'default', 'bind', 'interleave', 'weighted_interleave',\n"
+	     "    'chunk_interleave', 'preferred', 'preferred_many', or 'local'.\n", membind_env);
+      exit(1);
+    }
+    if ( ULIBC_verbose() && __membind_mpol >= 0 )
+      printf("ULIBC: ULIBC_MEMBIND=%s (%s)\n", membind_env, ULIBC_get_mempol_name(__membind_mpol));
+  }
+  
+  const char *page_env = getenv("ULIBC_PAGESIZE");
+  if ( page_env && *page_env ) {
+    int page = ULIBC_PAGE_MAX;
+    for (int i = 0; i < ULIBC_PAGE_MAX; ++i) {
+      if ( !strcmp(page_env, ULIBC_get_page_name(i)) ) page = i;
+    }
+    if ( page == ULIBC_PAGE_MAX ) {
+      printf("Unknown page size '%s'.\n"
+	     "    ULIBC supports 'default', 'base', 'thp', '2m', or '1g'.\n", page_env);
+      exit(1);
+    }
+    ULIBC_set_page_policy(page);
+  }
+  if ( ULIBC_verbose() )
+    printf("ULIBC: ULIBC_PAGESIZE=%s\n", ULIBC_get_page_name( ULIBC_get_page_policy() ));
+  
+  const char *touch_env = getenv("ULIBC_TOUCH");
+  if ( touch_env && *touch_env ) {
+    int touch = ULIBC_TOUCH_MAX;
+    for (int i = 0; i < ULIBC_TOUCH_MAX; ++i) {
+      if ( !strcmp(touch_env, ULIBC_get_touch_name(i)) ) touch = i;
+    }
+    if ( touch == ULIBC_TOUCH_MAX ) {
+      printf("Unknown touch strategy '%s'.\n"
+	     "    ULIBC supports 'stride' or 'populate'.\n", touch_env);
+      exit(1);
+    }
+    ULIBC_set_touch_policy(touch);
+  }
+  if ( ULIBC_verbose() )
+    printf("ULIBC: ULIBC_TOUCH=%s\n", ULIBC_get_touch_name( ULIBC_get_touch_policy() ));
+  
+  ULIBC_set_touch_async( getenvi("ULIBC_TOUCH_ASYNC", 0) );
+  if ( ULIBC_verbose() )
+    printf("ULIBC: ULIBC_TOUCH_ASYNC=%d\n", ULIBC_get_touch_async());
+  
+  const char *weights_env = getenv("ULIBC_MEMBIND_WEIGHTS");
+  if ( weights_env && *weights_env ) {
+    parse_interleave_weights(weights_env);
+    if ( ULIBC_verbose() )
+      printf("ULIBC: ULIBC_MEMBIND_WEIGHTS=%s\n", weights_env);
+  }
+  
+  const long chunk = getenvi("ULIBC_INTERLEAVE_CHUNK", DEFAULT_INTERLEAVE_CHUNK);
+  if ( chunk <= 0 ) {
+    printf("ULIBC_INTERLEAVE_CHUNK=%ld must be positive.\n", chunk);
+    exit(1);
+  }
+  ULIBC_set_interleave_chunk(chunk);
+  
+  ULIBC_set_spill_reserve( getenvi("ULIBC_SPILL_RESERVE", -1) );
+  if ( ULIBC_verbose() && ULIBC_get_spill_reserve() >= 0 )
+    printf("ULIBC: ULIBC_SPILL_RESERVE=%ld\n", ULIBC_get_spill_reserve());
+  
+  ULIBC_set_cache_limit( getenvi("ULIBC_CACHE_BYTES", 0) );
+  if ( ULIBC_verbose() )
+    printf("ULIBC: ULIBC_CACHE_BYTES=%ld\n", ULIBC_get_cache_limit());
+  return 0;
+}
+
+void *ULIBC_malloc_explict(size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+  return ULIBC_malloc_explict_page(size, mpol, nodemask, maxnode, ULIBC_get_page_policy());
+}
+
+/* hugetlbfs page size in bytes, or 0 for THP and base pages */
+static size_t hugetlb_size(int page) {
+  switch (page) {
+  case ULIBC_PAGE_HUGE_2M: return 1UL << 21;
+  case ULIBC_PAGE_HUGE_1G: return 1UL << 30;
+  default:                 return 0;
+  }
+}
+
+/* checks free hugetlbfs pages on the nodes in nodemask */
+static int enough_hugepages(size_t size, int page, unsigned long *nodemask, unsigned long maxnode) {
+  const size_t hpsz = hugetlb_size(page);
+  long avail = 0;
+  for (unsigned long i = 0; i < MIN(maxnode, (unsigned long)ULIBC_get_num_nodes()); ++i) {
+    if ( ISSET_BITMAP( (uint64_t *)nodemask, i ) )
+      avail += MAX( ULIBC_get_free_hugepages(i, hpsz), 0L );
+  }
+  return hpsz && (size_t)avail >= size / hpsz;
+}
+
+/* anonymous mapping with the page policy; updates size and page to the actual ones */
+static void *mmap_page_policy(size_t *size, int *page, unsigned long *nodemask, unsigned long maxnode) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void *p = MAP_FAILED;
+  
+#ifdef MAP_HUGETLB
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+  if ( hugetlb_size(*page) ) {
+    const size_t hpsz = hugetlb_size(*page);
+    const size_t bytes = ROUNDUP(*size, hpsz);
+    if ( enough_hugepages(bytes, *page, nodemask, maxnode) ) {
+      const int shift = (*page == ULIBC_PAGE_HUGE_1G) ? 30 : 21;
+      STATS_TIMED( STATS_MMAP, p = mmap(0, bytes, (PROT_READ | PROT_WRITE), flags | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), 0, 0) );
+    }
+    if ( p != MAP_FAILED ) {
+      *size = bytes;
+    } else {
+      if ( ULIBC_verbose() )
+	printf("ULIBC: no %s hugetlbfs pages for %ld bytes, falls back to thp\n",
+	       ULIBC_get_page_name(*page), bytes);
+      *page = ULIBC_PAGE_THP;
+    }
+  }
+#else
+  (void)nodemask, (void)maxnode;
+  if ( hugetlb_size(*page) )
+    *page = ULIBC_PAGE_THP;
+#endif
+  
+  if ( p == MAP_FAILED )
+    STATS_TIMED( STATS_MMAP, p = mmap(0, *size, (PROT_READ | PROT_WRITE), flags, 0, 0) );
+  if ( p == MAP_FAILED )
+    return NULL;
+  
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+  if ( *page == ULIBC_PAGE_THP ) {
+    if ( madvise(p, *size, MADV_HUGEPAGE) && ULIBC_verbose() > 1 )
+      printf("ULIBC: madvise(MADV_HUGEPAGE) failed (errno: %d)\n", errno);
+  } else if ( *page == ULIBC_PAGE_BASE ) {
+    madvise(p, *size, MADV_NOHUGEPAGE);
+  }
+#else
+  if ( *page == ULIBC_PAGE_THP || *page == ULIBC_PAGE_BASE )
+    *page = ULIBC_PAGE_DEFAULT;
+#endif
+  return p;
+}
+
+/* page size backing addr, read from /proc/self/smaps (0 if unknown) */
+size_t ULIBC_get_backing_page_size(void *addr) {
+  size_t pagesz = 0;
+#if defined(__linux__)
+  FILE *fp = fopen("/proc/self/smaps", "r");
+  if ( !fp ) return 0;
+  char line[LINE_MAX];
+  int found = 0;
+  size_t kernel_kB = 0, thp_kB = 0;
+  while ( fgets(line, LINE_MAX, fp) ) {
+    unsigned long start, end, kB;
+    if ( sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ') ) {
+      if ( found ) break;
+      found = ( start <= (uintptr_t)addr && (uintptr_t)addr < end );
+    } else if ( found ) {
+      if ( sscanf(line, "KernelPageSize: %lu kB", &kB) == 1 ) kernel_kB = kB;
+      if ( sscanf(line, "AnonHugePages: %lu kB", &kB) == 1 ) thp_kB = kB;
+    }
+  }
+  fclose(fp);
+  if ( found ) {
+    pagesz = kernel_kB << 10;
+    if ( thp_kB > 0 ) {
+      size_t thpsz = 1UL << 21;
+      if ( (fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r")) ) {
+	if ( fscanf(fp, "%lu", &thpsz) != 1 ) thpsz = 1UL << 21;
+	fclose(fp);
+      }
+      pagesz = MAX(pagesz, thpsz);
+    }
+  }
+#else
+  (void)addr;
+#endif
+  return pagesz;
+}
+
+/* --------------------
+ * print routines
+ * -------------------- */
+static void print_mattr_node(const struct mattr_node_t *m) {
+  printf("{ addr: %12p, bytes: %12ld (%7.3f GB), touched: %d, routine: %s",
+	 m->addr,
+	 m->bytes, (double)m->bytes/(1UL<<30),
+	 m->touched, routine_name(m->routine));
+  if ( m->routine == ULIBC_MMAP || m->routine == ULIBC_MMAP_FILE || m->routine == ULIBC_MMAP_SHM ) {
+    printf(", mpol: %25s, page: %7s, ", get_mempol_mode_name(m->mpol), ULIBC_get_page_name(m->page));
+    printf("nodemask: "); show_bitmap( ULIBC_get_num_nodes(), m->nodemask );
+    if ( m->unit )
+      printf(", unit: %ld", m->unit);
+    if ( m->reqnode >= 0 )
+      printf(", spilled from: %d", m->reqnode);
+  }
+  printf(" }");
+}
+
+static void print_mattr_residency(const struct mattr_node_t *m) {
+  size_t per_node[MAX_NODES];
+  const size_t resident = ULIBC_query_placement(m->addr, m->bytes, per_node);
+  size_t remote = 0;
+  printf("ULIBC:      resident: %.3f GB {", (double)resident/(1UL<<30));
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    if ( !per_node[k] ) continue;
+    printf(" %d: %.3f GB", k, (double)per_node[k]/(1UL<<30));
+    if ( m->routine == ULIBC_MMAP && !ISSET_BITMAP( (uint64_t *)m->nodemask, k ) )
+      remote += per_node[k];
+  }
+  printf(" }, off-nodemask: %.1f%%\n", resident ? 100.0 * remote / resident : 0.0);
+}
+
+void ULIBC_print_memory_pool_mode(int mode) {
+  if ( ULIBC_verbose() > 1 )
+    printf("ULIBC: ULIBC_print_memory_pool()\n");
+  size_t n = 0;
+  struct mattr_node_t **list = snapshot_mattr(&n);
+  for (size_t i = 0; i < n; ++i) {
+    printf("ULIBC: show ");
+    print_mattr_node( list[i] );
+    printf(" at %ld of %ld\n", i, n);
+    if ( mode == ULIBC_PRINT_RESIDENCY )
+      print_mattr_residency( list[i] );
+  }
+  put_mattr_list(list, n);
+  if ( ULIBC_verbose() > 1 )
+    printf("\n");
+}
+
+void ULIBC_print_memory_pool(void) {
+  ULIBC_print_memory_pool_mode(ULIBC_PRINT_ATTR);
+}
+
+
+/* --------------------
+ * page placement
+ *   query_page_nodes() is provided by each backend; it stores the node
+ *   of each page into status[] (negative if not resident), and returns
+ *   a negative value if the query is not supported.
+ * -------------------- */
+#ifndef ULIBC_PLACEMENT_SAMPLES
+#define ULIBC_PLACEMENT_SAMPLES 4096
+#endif
+#define PLACEMENT_BATCH 512
+
+static long query_page_nodes(unsigned long count, void **pages, int *status);
+
+/* returns resident bytes in [ptr, ptr+len), estimated from at most
+   ULIBC_PLACEMENT_SAMPLES pages; per_node_bytes has ULIBC_get_num_nodes() entries */
+size_t ULIBC_query_placement(const void *ptr, size_t len, size_t *per_node_bytes) {
+  const int nnodes = ULIBC_get_num_nodes();
+  if ( per_node_bytes ) {
+    for (int k = 0; k < nnodes; ++k)
+      per_node_bytes[k] = 0;
+  }
+  if ( !ptr || len == 0 ) return 0;
+  
+  const size_t pagesz = 1UL << 12;
+  const uintptr_t head = ALIGN_DOWN( (uintptr_t)ptr, pagesz );
+  const size_t npages = ( ROUNDUP( (uintptr_t)ptr + len, pagesz ) - head ) / pagesz;
+  const size_t nsamples = MIN( npages, (size_t)ULIBC_PLACEMENT_SAMPLES );
+  
+  void *pages[PLACEMENT_BATCH];
+  int status[PLACEMENT_BATCH];
+  size_t weight[PLACEMENT_BATCH];
+  size_t total = 0;
+  for (size_t s = 0; s < nsamples; s += PLACEMENT_BATCH) {
+    const size_t count = MIN( nsamples - s, (size_t)PLACEMENT_BATCH );
+    for (size_t i = 0; i < count; ++i) {
+      /* sample i stands for pages [lo, hi) */
+      const size_t lo = (s+i+0) * npages / nsamples;
+      const size_t hi = (s+i+1) * npages / nsamples;
+      pages[i]  = (void *)(head + lo * pagesz);
+      weight[i] = (hi - lo) * pagesz;
+      status[i] = -1;
+    }
+    if ( query_page_nodes(count, pages, status) < 0 )
+      return 0;
+    for (size_t i = 0; i < count; ++i) {
+      if ( 0 <= status[i] && status[i] < nnodes ) {
+	total += weight[i];
+	if ( per_node_bytes )
+	  per_node_bytes[ status[i] ] += weight[i];
+      }
+    }
+  }
+  return total;
+}
+
+
+/* --------------------
+ * mapping cache
+ *   Freed mappings are kept in per-node, size-bucketed lists while the
+ *   cached bytes stay within the limit (ULIBC_CACHE_BYTES, default 0:
+ *   disabled). The pages remain resident with the policy applied, and
+ *   an allocation with the same policy, nodemask, and page size takes
+ *   a cached mapping of the same size class instead of mmap+mbind.
+ *   release_mattr_node() is provided by each backend.
+ * -------------------- */
+#define MCACHE_NCLASSES 64
+
+static struct mattr_node_t *__mcache[MAX_NODES][MCACHE_NCLASSES];
+static pthread_mutex_t __mcache_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t __mcache_limit = 0;
+static size_t __mcache_bytes = 0;
+
+static void release_mattr_node(struct mattr_node_t *m);
+
+static int mcache_class(size_t bytes) {
+  int cls = 0;
+  while ( bytes >>= 1 )
+    ++cls;
+  return cls;
+}
+
+static int mcache_node(const unsigned long *nodemask, unsigned long maxnode) {
+  for (unsigned long i = 0; i < MIN(maxnode, (unsigned long)MAX_NODES); ++i) {
+    if ( ISSET_BITMAP( (uint64_t *)nodemask, i ) )
+      return i;
+  }
+  return 0;
+}
+
+/* requires __mcache_lock; returns evicted entries linked by next */
+static struct mattr_node_t *mcache_evict(size_t target) {
+  struct mattr_node_t *evicted = NULL;
+  for (int k = 0; k < MAX_NODES && __mcache_bytes > target; ++k) {
+    for (int c = MCACHE_NCLASSES-1; c >= 0 && __mcache_bytes > target; --c) {
+      while ( __mcache[k][c] && __mcache_bytes > target ) {
+	struct mattr_node_t *m = __mcache[k][c];
+	__mcache[k][c] = m->next;
+	__mcache_bytes -= m->bytes;
+	m->next = evicted;
+	evicted = m;
+      }
+    }
+  }
+  return evicted;
+}
+
+static void release_mattr_list(struct mattr_node_t *m) {
+  while ( m ) {
+    struct mattr_node_t *next = m->next;
+    m->next = NULL;
+    release_mattr_node(m);
+    m = next;
+  }
+}
+
+/* keeps a freed mapping; returns 0 if it has to be released */
+static int cache_mattr_node(struct mattr_node_t *m) {
+  if ( m->routine != ULIBC_MMAP || m->unit || m->bytes > __mcache_limit )
+    return 0;
+  pthread_mutex_lock( &__mcache_lock );
+  if ( m->bytes > __mcache_limit ) {
+    pthread_mutex_unlock( &__mcache_lock );
+    return 0;
+  }
+  struct mattr_node_t *evicted = mcache_evict(__mcache_limit - m->bytes);
+  const int node = mcache_node(m->nodemask, m->maxnode);
+  const int cls = mcache_class(m->bytes);
+  m->next = __mcache[node][cls];
+  __mcache[node][cls] = m;
+  __mcache_bytes += m->bytes;
+  pthread_mutex_unlock( &__mcache_lock );
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: cache ");
+    print_mattr_node( m );
+    printf("\n");
+  }
+  release_mattr_list(evicted);
+  return 1;
+}
+
+/* takes a cached mapping and registers it again */
+static struct mattr_node_t *reuse_cached_mattr(size_t size, int mpol, unsigned long *nodemask,
+					       unsigned long maxnode, int page) {
+  if ( __mcache_bytes == 0 )
+    return NULL;
+  const int node = mcache_node(nodemask, maxnode);
+  const int cls = mcache_class(size);
+  const size_t masksz = MIN(maxnode, (unsigned long)MAX_NODES)/sizeof(unsigned long);
+  
+  struct mattr_node_t *m = NULL;
+  pthread_mutex_lock( &__mcache_lock );
+  for (struct mattr_node_t **p = &__mcache[node][cls]; *p; p = &(*p)->next) {
+    struct mattr_node_t *q = *p;
+    if ( q->bytes >= size && q->mpol == mpol && q->page == page &&
+	 q->maxnode == maxnode && !memcmp(q->nodemask, nodemask, masksz) ) {
+      *p = q->next;
+      __mcache_bytes -= q->bytes;
+      m = q;
+      break;
+    }
+  }
+  pthread_mutex_unlock( &__mcache_lock );
+  if ( !m ) return NULL;
+  
+  /* a cached mapping may hold old data, and is never zero-touched */
+  struct mattr_node_t *res = insert_mattr( m->bytes, m->addr );
+  res->touched = 1;
+  res->routine = m->routine;
+  res->mpol    = m->mpol;
+  res->page    = m->page;
+  res->maxnode = m->maxnode;
+  memcpy( res->nodemask, m->nodemask, sizeof(m->nodemask) );
+  stats_alloc(res, m->umpol);
+  free(m);
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: reuse ");
+    print_mattr_node( res );
+    printf("\n");
+  }
+  return res;
+}
+
+size_t ULIBC_get_cache_limit(void) { return __mcache_limit; }
+size_t ULIBC_get_cached_bytes(void) { return __mcache_bytes; }
+
+void ULIBC_set_cache_limit(size_t bytes) {
+  pthread_mutex_lock( &__mcache_lock );
+  __mcache_limit = bytes;
+  struct mattr_node_t *evicted = mcache_evict(bytes);
+  pthread_mutex_unlock( &__mcache_lock );
+  release_mattr_list(evicted);
+}
+
+/* releases cached mappings until at most bytes remain; returns released bytes */
+size_t ULIBC_trim_cache(size_t bytes) {
+  pthread_mutex_lock( &__mcache_lock );
+  const size_t before = __mcache_bytes;
+  struct mattr_node_t *evicted = mcache_evict(bytes);
+  const size_t released = before - __mcache_bytes;
+  pthread_mutex_unlock( &__mcache_lock );
+  release_mattr_list(evicted);
+  return released;
+}
+
+
+/* --------------------
+ * touch routines
+ * -------------------- */
+void *touch_seq(void *p, size_t length) {
+  unsigned char *x = p;
+  const size_t stride = 1UL << 12;
+  for (size_t k = 0; k < length; k += stride)
+    x[k] = (unsigned char)(-1);
+  return p;
+}
+
+#if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/* faults [p, p+length) in the kernel on Linux 5.14 or later; returns 0 on success */
+static int __populate_unsupported = 0;
+static int populate_write(void *p, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+  if ( !__populate_unsupported && length > 0 ) {
+    const size_t pagesz = 1UL << 12;
+    const uintptr_t head = ALIGN_DOWN( (uintptr_t)p, pagesz );
+    const uintptr_t tail = ROUNDUP( (uintptr_t)p + length, pagesz );
+    if ( !madvise((void *)head, tail-head, MADV_POPULATE_WRITE) )
+      return 0;
+    if ( errno == EINVAL ) {
+      __populate_unsupported = 1;
+      if ( ULIBC_verbose() )
+	printf("ULIBC: MADV_POPULATE_WRITE is not supported, falls back to stride\n");
+    }
+  }
+#else
+  (void)p, (void)length;
+#endif
+  return -1;
+}
+
+/* falls back to touch_seq() */
+void *touch_populate(void *p, size_t length) {
+  if ( !populate_write(p, length) )
+    return p;
+  return touch_seq(p, length);
+}
+
+/* faults [p, p+length) in for writing without changing its contents,
+   so that the owner may write to it concurrently */
+static void *touch_keep(void *p, size_t length) {
+  if ( !populate_write(p, length) )
+    return p;
+  unsigned char *x = p;
+  const size_t stride = 1UL << 12;
+  for (size_t k = 0; k < length; k += stride)
+    __atomic_fetch_add( &x[k], 0, __ATOMIC_RELAXED );
+  return p;
+}
+
+static void *touch_range(void *p, size_t length) {
+  if ( ULIBC_get_touch_policy() == ULIBC_TOUCH_POPULATE )
+    return touch_populate(p, length);
+  else
+    return touch_seq(p, length);
+}
+
+void *touch_flat_omp(void *p, size_t length) {
+  unsigned char *x = p;
+  const size_t stride = 1UL << 12;
+  if ( ULIBC_get_touch_policy() == ULIBC_TOUCH_POPULATE ) {
+    OMP("omp parallel") {
+      long ls, le;
+      prange(ROUNDUP(length, stride) / stride, 0, omp_get_num_threads(), omp_get_thread_num(), &ls, &le);
+      if ( ls < le )
+	touch_populate( &x[ls * stride], MIN((size_t)le * stride, length) - ls * stride );
+    }
+    return p;
+  }
+  OMP("omp parallel for")
+    for (size_t k = 0; k < length; k += stride)
+      x[k] = (unsigned char)(-1);
+  return p;
+}
+
+void ULIBC_touch_memory_pool_naive(void) {
+  if ( ULIBC_verbose() > 1 )
+    printf("ULIBC: ULIBC_touch_memory_pool()\n");
+  size_t n = 0;
+  struct mattr_node_t **list = snapshot_mattr(&n);
+  for (size_t i = 0; i < n; ++i) {
+    struct mattr_node_t *m = list[i];
+    if ( m->touched || m->touching )
+      continue;
+    
+    STATS_TIMED( STATS_TOUCH, touch_flat_omp( m->addr, m->bytes ) );
+    m->touched = 1;
+    stats_place(m);
+    
+    if ( ULIBC_verbose() > 1 ) {
+      printf("ULIBC: [%2d] touched ", ULIBC_get_thread_num());
+      print_mattr_node( m );
+      printf("\n");
+    }
+  }
+  put_mattr_list(list, n);
+  if ( ULIBC_verbose() > 1 )
+    printf("\n");
+}
+
+/* --------------------
+ * fast touch routines
+ *   All untouched ranges are batched into one work list per NUMA
+ *   node. Each entry is split among the nodes of its nodemask in
+ *   proportion to their thread counts, and the threads of a node
+ *   touch their contiguous share of the node's list in a single pass.
+ * -------------------- */
+struct touch_range_t {
+  unsigned char *addr;
+  size_t bytes;
+};
+
+static struct touch_list_t {
+  struct touch_range_t *range;
+  size_t count;
+  size_t total;
+} __touch_list[MAX_NODES];
+
+static int __touch_nthrs[MAX_NODES];	/* #threads on each node */
+static int __touch_lrank[MAX_CPUS];	/* thread rank in its node */
+static int64_t untouched_count;
+
+int64_t count_untouched_mattr_node(void) {
+  size_t n = 0;
+  struct mattr_node_t **list = snapshot_mattr(&n);
+  untouched_count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if ( ! list[i]->touched )
+      ++untouched_count;
+  }
+  put_mattr_list(list, n);
+  return untouched_count;
+}
+
+static int touch_thread_node(int tid) {
+  return ULIBC_get_cpuinfo( ULIBC_get_numainfo(tid).proc ).node;
+}
+
+/* splits m among the nodes in its nodemask; returns 0 if no thread can touch it */
+static int add_touch_ranges(struct mattr_node_t *m) {
+  const unsigned long maxnode = MIN(m->maxnode, (unsigned long)ULIBC_get_num_nodes());
+  int nthrs = 0;
+  for (unsigned long k = 0; k < maxnode; ++k) {
+    if ( ISSET_BITMAP( (uint64_t *)m->nodemask, k ) )
+      nthrs += __touch_nthrs[k];
+  }
+  if ( nthrs == 0 )
+    return 0;
+
+  int prefix = 0;
+  for (unsigned long k = 0; k < maxnode; ++k) {
+    if ( !ISSET_BITMAP( (uint64_t *)m->nodemask, k ) || __touch_nthrs[k] == 0 )
+      continue;
+    long ls, le, ns, ne;
+    prange(m->bytes, 0, nthrs, prefix, &ls, &le);
+    prefix += __touch_nthrs[k];
+    prange(m->bytes, 0, nthrs, prefix-1, &ns, &ne);
+    struct touch_list_t *tl = &__touch_list[k];
+    if ( ne <= ls ) continue;
+    tl->range[tl->count].addr  = (unsigned char *)m->addr + ls;
+    tl->range[tl->count].bytes = ne - ls;
+    tl->total += ne - ls;
+    ++tl->count;
+  }
+  return 1;
+}
+
+static void *pth_touch(void *arg) {
+  const int tid = (int)(intptr_t)arg;
+  ULIBC_bind_thread_explicit(tid);
+
+  const int node = touch_thread_node(tid);
+  const struct touch_list_t *tl = &__touch_list[node];
+  long ls, le;
+  prange(tl->total, 0, __touch_nthrs[node], __touch_lrank[tid], &ls, &le);
+
+  size_t off = 0;
+  for (size_t i = 0; i < tl->count && off < (size_t)le; ++i) {
+    const struct touch_range_t *r = &tl->range[i];
+    const size_t head = MAX( off, (size_t)ls );
+    const size_t tail = MIN( off + r->bytes, (size_t)le );
+    if ( head < tail )
+      touch_range( r->addr + (head - off), tail - head );
+    off += r->bytes;
+  }
+
+  if ( ULIBC_verbose() > 2 )
+    printf("ULIBC: [%2d] touched %ld bytes of %ld on NUMA-node %d\n",
+	   tid, le-ls, tl->total, node);
+  return arg;
+}
+
+void ULIBC_touch_memory_pool(void) {
+  const int nthreads = ULIBC_get_online_procs();
+  
+  /* per-node thread counts and ranks */
+  for (int k = 0; k < MAX_NODES; ++k)
+    __touch_nthrs[k] = 0;
+  for (int i = 0; i < nthreads; ++i) {
+    const int node = touch_thread_node(i);
+    __touch_lrank[i] = __touch_nthrs[node]++;
+  }
+  
+  /* work lists */
+  size_t n = 0;
+  struct mattr_node_t **list = snapshot_mattr(&n);
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    __touch_list[k].range = malloc( sizeof(struct touch_range_t) * (n+1) );
+    __touch_list[k].count = 0;
+    __touch_list[k].total = 0;
+  }
+  
+  untouched_count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if ( list[i]->touched || list[i]->touching || !add_touch_ranges(list[i]) ) {
+      put_mattr( list[i] );
+      list[i] = NULL;
+    } else
+      ++untouched_count;
+  }
+  
+  pthread_t pth[MAX_CPUS];
+  if ( ULIBC_verbose() > 1 )
+    printf("ULIBC: ULIBC_touch_memory_pool() touches %" PRId64 " entries with %d posix threads\n",
+	   untouched_count, nthreads);
+  
+  const double t = get_msecs();
+  for (int i = 0; i < nthreads; ++i) {
+    pthread_create( &pth[i], NULL, pth_touch, (void *)(intptr_t)i );
+  }
+  for (int i = 0; i < nthreads; ++i) {
+    pthread_join( pth[i], NULL );
+  }
+  stats_time(STATS_TOUCH, get_msecs() - t);
+  
+  for (size_t i = 0; i < n; ++i) {
+    if ( !list[i] ) continue;
+    list[i]->touched = 1;
+    stats_place( list[i] );
+    if ( ULIBC_verbose() > 1 ) {
+      printf("ULIBC: touched ");
+      print_mattr_node( list[i] );
+      printf("\n");
+    }
+  }
+  put_mattr_list(list, n);
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    free( __touch_list[k].range );
+    __touch_list[k].range = NULL;
+  }
+  
+  /* naive (entries whose nodes have no threads) */
+  ULIBC_touch_memory_pool_naive();
+}
+
+
+/* --------------------
+ * asynchronous touch
+ *   A worker thread bound to each online NUMA node touches the ranges
+ *   queued for the node in the background at the lowest priority.
+ *   An allocation is split among the nodes of its nodemask, and
+ *   m->touching counts its queued pieces; ULIBC_wait_touched() waits
+ *   until it becomes 0. The workers are started at the first request.
+ *   The caller may write to an allocation while it is queued, so the
+ *   workers fault the pages in by touch_keep(), which never changes
+ *   the contents.
+ * -------------------- */
+struct async_piece_t {
+  struct mattr_node_t *m;
+  unsigned char *addr;
+  size_t bytes;
+  struct async_piece_t *next;
+};
+
+static struct async_queue_t {
+  struct async_piece_t *head, *tail;
+  pthread_cond_t ready;
+  int running;
+} __async[MAX_NODES];
+
+static pthread_mutex_t __async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __async_done = PTHREAD_COND_INITIALIZER;
+static pthread_once_t __async_once = PTHREAD_ONCE_INIT;
+static size_t __async_pending = 0;
+static int __touch_async = 0;
+
+int ULIBC_get_touch_async(void) { return __touch_async; }
+void ULIBC_set_touch_async(int async) { __touch_async = ( async != 0 ); }
+
+static void lower_thread_priority(void) {
+#if defined(__linux__) && defined(SYS_gettid)
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#endif
+}
+
+static void *pth_async_touch(void *arg) {
+  const int node = (int)(intptr_t)arg;
+  struct async_queue_t *q = &__async[ ULIBC_get_online_nodeidx(node) ];
+  ULIBC_bind_node(node);
+  lower_thread_priority();
+  
+  for (;;) {
+    pthread_mutex_lock( &__async_lock );
+    while ( !q->head )
+      pthread_cond_wait( &q->ready, &__async_lock );
+    struct async_piece_t *pc = q->head;
+    q->head = pc->next;
+    if ( !q->head ) q->tail = NULL;
+    pthread_mutex_unlock( &__async_lock );
+    
+    STATS_TIMED( STATS_TOUCH, touch_keep(pc->addr, pc->bytes) );
+    
+    pthread_mutex_lock( &__async_lock );
+    if ( --pc->m->touching == 0 ) {
+      pc->m->touched = 1;
+      stats_place(pc->m);
+    }
+    --__async_pending;
+    pthread_cond_broadcast( &__async_done );
+    pthread_mutex_unlock( &__async_lock );
+    free(pc);
+  }
+  return NULL;
+}
+
+static void start_async_workers(void) {
+  for (int k = 0; k < MAX_NODES; ++k) {
+    __async[k].head = __async[k].tail = NULL;
+    __async[k].running = 0;
+    pthread_cond_init( &__async[k].ready, NULL );
+  }
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    pthread_t pth;
+    if ( pthread_create( &pth, NULL, pth_async_touch, (void *)(intptr_t)k ) )
+      continue;
+    pthread_detach(pth);
+    __async[ ULIBC_get_online_nodeidx(k) ].running = 1;
+  }
+  if ( ULIBC_verbose() )
+    printf("ULIBC: started %d asynchronous touch workers\n", ULIBC_get_online_nodes());
+}
+
+/* requires __async_lock; returns #queued pieces */
+static int queue_async_touch(struct mattr_node_t *m) {
+  if ( m->touched || m->touching ) return 0;
+  if ( __atomic_load_n( &m->refs, __ATOMIC_SEQ_CST ) >= MATTR_DYING ) return 0;	/* being freed */
+  const unsigned long maxnode = MIN(m->maxnode, (unsigned long)MAX_NODES);
+  int ell = 0;
+  for (unsigned long k = 0; k < maxnode; ++k) {
+    if ( ISSET_BITMAP( (uint64_t *)m->nodemask, k ) && __async[k].running )
+      ++ell;
+  }
+  if ( ell == 0 ) return 0;
+  
+  const size_t pagesz = 1UL << 12;
+  const long npages = ROUNDUP(m->bytes, pagesz) / pagesz;
+  int id = 0;
+  for (unsigned long k = 0; k < maxnode; ++k) {
+    if ( !ISSET_BITMAP( (uint64_t *)m->nodemask, k ) || !__async[k].running )
+      continue;
+    long ls, le;
+    prange(npages, 0, ell, id++, &ls, &le);
+    if ( ls >= le ) continue;
+    struct async_piece_t *pc = malloc( sizeof(struct async_piece_t) );
+    pc->m     = m;
+    pc->addr  = (unsigned char *)m->addr + ls * pagesz;
+    pc->bytes = MIN((size_t)le * pagesz, m->bytes) - ls * pagesz;
+    pc->next  = NULL;
+    if ( __async[k].tail ) __async[k].tail->next = pc;
+    else                   __async[k].head = pc;
+    __async[k].tail = pc;
+    ++m->touching;
+    ++__async_pending;
+    pthread_cond_signal( &__async[k].ready );
+  }
+  return m->touching;
+}
+
+/* queues the allocation at ptr; returns 0, or -1 if it cannot be queued */
+int ULIBC_touch_async(void *ptr) {
+  struct mattr_node_t *m = find_mattr(ptr);
+  if ( !m ) return -1;
+  pthread_once( &__async_once, start_async_workers );
+  pthread_mutex_lock( &__async_lock );
+  const int res = ( m->touched || queue_async_touch(m) ) ? 0 : -1;
+  pthread_mutex_unlock( &__async_lock );
+  put_mattr(m);
+  return res;
+}
+
+void ULIBC_touch_memory_pool_async(void) {
+  pthread_once( &__async_once, start_async_workers );
+  size_t n = 0;
+  struct mattr_node_t **list = snapshot_mattr(&n);
+  pthread_mutex_lock( &__async_lock );
+  for (size_t i = 0; i < n; ++i)
+    queue_async_touch( list[i] );
+  pthread_mutex_unlock( &__async_lock );
+  put_mattr_list(list, n);
+}
+
+/* queues a new allocation if ULIBC_TOUCH_ASYNC is set */
+static void async_touch_new(struct mattr_node_t *m) {
+  if ( !__touch_async ) return;
+  pthread_once( &__async_once, start_async_workers );
+  pthread_mutex_lock( &__async_lock );
+  queue_async_touch(m);
+  pthread_mutex_unlock( &__async_lock );
+}
+
+/* waits for the pieces of m, or all pieces if m is NULL */
+static void wait_async_touch(const struct mattr_node_t *m) {
+  pthread_mutex_lock( &__async_lock );
+  while ( m ? m->touching > 0 : __async_pending > 0 )
+    pthread_cond_wait( &__async_done, &__async_lock );
+  pthread_mutex_unlock( &__async_lock );
+}
+
+/* waits until the allocation containing ptr is touched */
+int ULIBC_wait_touched(void *ptr) {
+  struct mattr_node_t *m = find_mattr_range(ptr);
+  if ( !m ) return -1;
+  wait_async_touch(m);
+  put_mattr(m);
+  return 0;
+}
+
+/* keeps the touchers away from an allocation whose contents are in use */
+int ULIBC_mark_touched(void *ptr) {
+  struct mattr_node_t *m = find_mattr(ptr);
+  if ( !m ) return -1;
+  m->touched = 1;
+  put_mattr(m);
+  return 0;
+}
+
+
+/* --------------------
+ * memory usages
+ * -------------------- */
+/* from the live counters of the allocation statistics */
+size_t ULIBC_memory_usage_node(unsigned long maxnode, size_t *usage) {
+  size_t total = 0;
+  for (unsigned long i = 0; i < MAX_NODES; ++i) {
+    const size_t bytes = __atomic_load_n( &__stats_node[i].bytes, __ATOMIC_RELAXED );
+    if ( usage && i < maxnode )
+      usage[i] = bytes;
+    total += bytes;
+  }
+  return total;
+}
+
+size_t ULIBC_memory_usage(void) {
+  return ULIBC_memory_usage_node(0, NULL);
+}
+
 
 /* --------------------
- * print routines
+ * page migration
+ *   mbind_area() is provided by each backend; it applies the ULIBC
+ *   policy mpol to [addr, addr+len), moving the resident pages if move
+ *   is set. A migration applies the policy once without moving, which
+ *   keeps the range in a single VMA, and then the threads of the
+ *   destination nodes move their shares of the resident pages in
+ *   parallel by move_page_nodes(), so that the pages are copied by the
+ *   node-local threads. move_page_nodes() is provided by each backend
+ *   as well; it returns a negative value if it is not supported, and
+ *   then the pages are moved by a single mbind_area().
  * -------------------- */
-static void print_mattr_node(const struct mattr_node_t *m) {
-  printf("{ addr: %12p, bytes: %12ld (%7.3f GB), touched: %d, routine: %s",
-	 m->addr,
-	 m->bytes, (double)m->bytes/(1UL<<30),
-	 m->touched, routine_name(m->routine));
-  if ( m->routine == ULIBC_MMAP ) {
-    printf(", mpol: %25s, ", get_mempol_mode_name(m->mpol));
-    printf("nodemask: "); show_bitmap( ULIBC_get_num_nodes(), m->nodemask );
+static int mbind_area(void *addr, size_t len, int mpol,
+		      unsigned long *nodemask, unsigned long maxnode, int move);
+static long move_page_nodes(unsigned long count, void **pages, const int *nodes, int *status);
+static int is_striped_mpol(int mpol);
+
+/* thread indices on the nodes in nodemask */
+static int nodemask_threads(unsigned long *nodemask, unsigned long maxnode, int *tids) {
+  int nthrs = 0;
+  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
+    const int node = touch_thread_node(i);
+    if ( (unsigned long)node < maxnode && ISSET_BITMAP( (uint64_t *)nodemask, node ) )
+      tids[nthrs++] = i;
   }
-  printf(" }");
+  return nthrs;
 }
 
-static void twalk_print_mattr_node(const void *nodep, const VISIT order, const int level) {
-  if ( order != postorder && order != leaf )
-    return;
+struct migrate_arg_t {
+  int tid, rank, nthrs;
+  unsigned char *addr;
+  size_t bytes;
+  int mpol;
+  int nnodes;				/* #nodes in the nodemask */
+  const int *nodes;			/* nodes in the nodemask */
+  long err;
+};
+
+/* destination of the page at addr; the local node of the thread for a
+   bound range, or the node of the kernel's round for an interleaved one */
+static int migrate_node(const struct migrate_arg_t *a, uintptr_t addr, int local) {
+  switch (a->mpol) {
+  case ULIBC_MPOL_INTERLEAVE:
+    return a->nodes[ (addr >> 12) % a->nnodes ];
+  case ULIBC_MPOL_PREFERRED:
+    return a->nodes[0];
+  default:
+    for (int k = 0; k < a->nnodes; ++k)
+      if ( a->nodes[k] == local ) return local;
+    return a->nodes[0];
+  }
+}
+
+static void *pth_migrate(void *arg) {
+  struct migrate_arg_t *a = arg;
+  const size_t pagesz = 1UL << 12;
+  int local = -1;
+  if ( a->tid >= 0 ) {
+    ULIBC_bind_thread_explicit(a->tid);
+    local = touch_thread_node(a->tid);
+  }
   
-  printf("ULIBC: show ");
-  struct mattr_node_t *m = *(struct mattr_node_t **)nodep;
-  print_mattr_node(m);
-  printf(" in depth %d\n", level);
+  long ls, le;
+  prange(a->bytes / pagesz, 0, a->nthrs, a->rank, &ls, &le);
+  void *pages[PLACEMENT_BATCH];
+  int nodes[PLACEMENT_BATCH], status[PLACEMENT_BATCH];
+  for (long i = ls; i < le && !a->err; i += PLACEMENT_BATCH) {
+    const long count = MIN( le - i, (long)PLACEMENT_BATCH );
+    for (long j = 0; j < count; ++j) {
+      pages[j] = a->addr + (i+j) * pagesz;
+      nodes[j] = migrate_node(a, (uintptr_t)pages[j], local);
+    }
+    /* pages which are not resident fail by themselves, and fault by the policy */
+    if ( move_page_nodes(count, pages, nodes, status) < 0 )
+      a->err = -1;
+  }
+  return arg;
 }
 
-void ULIBC_print_memory_pool(void) {
-  if ( ULIBC_verbose() > 1 )
-    printf("ULIBC: ULIBC_print_memory_pool()\n");
-  twalk( __mattr_tree_root, twalk_print_mattr_node );
-  if ( ULIBC_verbose() > 1 )
-    printf("\n");
+static int migrate_area(void *ptr, size_t len, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+  const size_t pagesz = 1UL << 12;
+  unsigned char *head = (unsigned char *)ALIGN_DOWN( (uintptr_t)ptr, pagesz );
+  const size_t bytes = ROUNDUP( (uintptr_t)ptr + len, pagesz ) - (uintptr_t)head;
+  
+  /* the policy of the range, and then its resident pages */
+  if ( mbind_area(head, bytes, mpol, nodemask, maxnode, 0) )
+    return -1;
+  int nodes[MAX_NODES], nnodes = 0;
+  for (unsigned long k = 0; k < MIN(maxnode, (unsigned long)MAX_NODES); ++k) {
+    if ( ISSET_BITMAP( (uint64_t *)nodemask, k ) )
+      nodes[nnodes++] = k;
+  }
+  if ( nnodes == 0 || mpol == ULIBC_MPOL_DEFAULT || mpol == ULIBC_MPOL_LOCAL )
+    return 0;
+  
+  /* threads on the destination nodes */
+  int tids[MAX_CPUS];
+  const int nthrs = nodemask_threads(nodemask, maxnode, tids);
+  struct migrate_arg_t *args = malloc( sizeof(struct migrate_arg_t) * (nthrs+1) );
+  for (int i = 0; i < MAX(nthrs, 1); ++i) {
+    args[i].tid    = nthrs ? tids[i] : -1;
+    args[i].rank   = i;
+    args[i].nthrs  = MAX(nthrs, 1);
+    args[i].addr   = head;
+    args[i].bytes  = bytes;
+    args[i].mpol   = mpol;
+    args[i].nnodes = nnodes;
+    args[i].nodes  = nodes;
+    args[i].err    = 0;
+  }
+  
+  long err = 0;
+  if ( nthrs == 0 ) {
+    pth_migrate(&args[0]);
+    err = args[0].err;
+  } else {
+    pthread_t pth[MAX_CPUS];
+    for (int i = 0; i < nthrs; ++i)
+      pthread_create( &pth[i], NULL, pth_migrate, &args[i] );
+    for (int i = 0; i < nthrs; ++i) {
+      pthread_join( pth[i], NULL );
+      err |= args[i].err;
+    }
+  }
+  free(args);
+  
+  /* move_pages() is not available */
+  if ( err )
+    err = mbind_area(head, bytes, mpol, nodemask, maxnode, 1);
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: migrate %p (%ld bytes) to nodemask: ", head, bytes);
+    show_bitmap( ULIBC_get_num_nodes(), nodemask );
+    printf(" with %d threads%s\n", nthrs, err ? " (failed)" : "");
+  }
+  return err ? -1 : 0;
+}
+
+/* records the new policy if [ptr, ptr+len) covers the whole allocation;
+   the stripes of a striped policy are recorded by stripe_mattr_node() */
+static void update_mattr_policy(void *ptr, size_t len, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+  struct mattr_node_t *m = find_mattr_range(ptr);
+  if ( !m ) return;
+  if ( m->addr != ptr || m->bytes > len ) {
+    put_mattr(m);
+    return;
+  }
+  m->mpol = get_mempol_mode(mpol);
+  m->maxnode = MIN(maxnode, (unsigned long)MAX_NODES);
+  memset( m->nodemask, 0x00, sizeof(m->nodemask) );
+  memcpy( m->nodemask, nodemask, m->maxnode/8 );
+  if ( !is_striped_mpol(mpol) ) {
+    m->unit = 0;
+    m->nstripe = 0;
+  }
+  stats_rebind(m, mpol);
+  put_mattr(m);
 }
 
+/* moves [ptr, ptr+len) onto the node-th online NUMA node */
+int ULIBC_migrate(void *ptr, size_t len, int node) {
+  if ( !ptr || len == 0 ) return -1;
+  unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  SET_BITMAP( (uint64_t *)nodemask, ULIBC_get_online_nodeidx(node) );
+  if ( migrate_area(ptr, len, ULIBC_MPOL_BIND, nodemask, MAX_NODES) )
+    return -1;
+  update_mattr_policy(ptr, len, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+  return 0;
+}
 
 /* --------------------
- * touch routines
+ * striped interleave
+ *   A range is divided into units, which are assigned to the nodes of
+ *   the nodemask round by round; each node takes as many consecutive
+ *   units per round as its weight (1 for ULIBC_MPOL_CHUNK_INTERLEAVE,
+ *   whose unit is the interleave chunk). Consecutive units of a node are
+ *   bound by a single mbind_area(), so each run of them is a VMA. The
+ *   runs of an allocation are kept below vm.max_map_count/8: the unit
+ *   grows for very large allocations, whereas an allocation whose chunk
+ *   is given per call fails instead.
  * -------------------- */
-void *touch_seq(void *p, size_t length) {
-  unsigned char *x = p;
-  const size_t stride = 1UL << 12;
-  for (size_t k = 0; k < length; k += stride)
-    x[k] = (unsigned char)(-1);
-  return p;
+#ifndef STRIPE_WEIGHTED_UNIT
+#define STRIPE_WEIGHTED_UNIT (1UL << 21)
+#endif
+#define DEFAULT_MAX_MAP_COUNT 65530
+
+static void *malloc_explict_stripe(size_t size, int mpol, unsigned long *nodemask,
+				   unsigned long maxnode, int page, size_t unit);
+
+/* maximum #runs of an allocation */
+static size_t stripe_max_runs(void) {
+  static long max_map_count = 0;
+  if ( max_map_count == 0 ) {
+    long n = DEFAULT_MAX_MAP_COUNT;
+    FILE *fp = fopen("/proc/sys/vm/max_map_count", "r");
+    if ( fp ) {
+      if ( fscanf(fp, "%ld", &n) != 1 || n <= 0 ) n = DEFAULT_MAX_MAP_COUNT;
+      fclose(fp);
+    }
+    max_map_count = n;
+  }
+  return MAX( max_map_count / 8, 1L );
 }
 
-void *touch_flat_omp(void *p, size_t length) {
-  unsigned char *x = p;
-  const size_t stride = 1UL << 12;
-  OMP("omp parallel for")
-    for (size_t k = 0; k < length; k += stride)
-      x[k] = (unsigned char)(-1);
-  return p;
+static int is_striped_mpol(int mpol) {
+  return mpol == ULIBC_MPOL_WEIGHTED_INTERLEAVE || mpol == ULIBC_MPOL_CHUNK_INTERLEAVE;
 }
 
-static void twalk_touch_mattr_node(const void *nodep, const VISIT order, const int level) {
-  if ( order != postorder && order != leaf )
-    return;
-  
-  struct mattr_node_t *m = *(struct mattr_node_t **)nodep;
-  if ( m->touched )
-    return;
-  
-  touch_flat_omp( m->addr, m->bytes );
-  m->touched = 1;
+/* node of each unit in a round; returns #units per round */
+static int make_stripe(unsigned long *nodemask, unsigned long maxnode, int weighted, unsigned char *stripe) {
+  int w[MAX_NODES], total = 0;
+  for (unsigned long k = 0; k < MAX_NODES; ++k) {
+    w[k] = 0;
+    if ( k < maxnode && ISSET_BITMAP( (uint64_t *)nodemask, k ) )
+      w[k] = weighted ? ULIBC_get_interleave_weight(k) : 1;
+    total += w[k];
+  }
+  int n = 0;
+  for (int k = 0; k < MAX_NODES; ++k) {
+    if ( w[k] == 0 ) continue;
+    if ( total > MATTR_MAX_STRIPE )
+      w[k] = MAX( w[k] * MATTR_MAX_STRIPE / total, 1 );
+    for (int i = 0; i < w[k] && n < MATTR_MAX_STRIPE; ++i)
+      stripe[n++] = k;
+  }
+  return n;
+}
+
+static int stripe_area(unsigned char *addr, size_t bytes, size_t unit, int nstripe, const unsigned char *stripe) {
+  int err = 0;
+  size_t u = 0;
+  for (size_t off = 0; off < bytes; ) {
+    const int node = stripe[u % nstripe];
+    size_t len = 0;
+    while ( off + len < bytes && stripe[u % nstripe] == node ) {
+      len += unit;
+      ++u;
+    }
+    len = MIN(len, bytes - off);
+    unsigned long mask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+    SET_BITMAP( (uint64_t *)mask, node );
+    err |= mbind_area(addr + off, len, ULIBC_MPOL_BIND, mask, MAX_NODES, 1);
+    off += len;
+  }
+  return err;
+}
+
+/* #runs of consecutive units on the same node in nunits units */
+static size_t stripe_runs(size_t nunits, int nstripe, const unsigned char *stripe) {
+  size_t runs = nunits ? 1 : 0;
+  for (int b = 0; b < nstripe; ++b) {
+    if ( stripe[b] == stripe[ (b + nstripe - 1) % nstripe ] ) continue;
+    /* each unit u > 0 with u % nstripe == b starts a run */
+    const size_t first = b ? (size_t)b : (size_t)nstripe;
+    if ( first < nunits )
+      runs += ( nunits - 1 - first ) / nstripe + 1;
+  }
+  return runs;
+}
+
+/* binds m by stripes; mpol is a striped ULIBC policy, and chunk is the
+   unit given per call (0: default) */
+static int stripe_mattr_node(struct mattr_node_t *m, int mpol, unsigned long *nodemask,
+			     unsigned long maxnode, size_t chunk) {
+  const int weighted = ( mpol == ULIBC_MPOL_WEIGHTED_INTERLEAVE );
+  size_t unit = chunk ? chunk : weighted ? STRIPE_WEIGHTED_UNIT : __interleave_chunk;
+  const size_t align = hugetlb_size(m->page) ? hugetlb_size(m->page) : (1UL << 12);
+  unit = ROUNDUP( MAX(unit, align), align );
   
-  if ( ULIBC_verbose() > 1 ) {
-    printf("ULIBC: [%2d] touched ", ULIBC_get_thread_num());
-    print_mattr_node( m );
-    printf(" in depth %d\n", level);
+  m->nstripe = make_stripe(nodemask, maxnode, weighted, m->stripe);
+  if ( m->nstripe == 0 ) return -1;
+  while ( stripe_runs( (m->bytes + unit - 1) / unit, m->nstripe, m->stripe ) > stripe_max_runs() ) {
+    if ( chunk ) {
+      if ( ULIBC_verbose() )
+	printf("ULIBC: chunk %ld of %p makes more than %ld VMAs\n", unit, m->addr, stripe_max_runs());
+      m->nstripe = 0;
+      return -1;
+    }
+    unit <<= 1;
   }
+  m->unit = unit;
+  const int err = stripe_area(m->addr, m->bytes, m->unit, m->nstripe, m->stripe);
+  if ( err && ULIBC_verbose() )
+    printf("ULIBC: cannot bind stripes of %p (errno: %d)\n", m->addr, errno);
+  return err;
 }
 
-void ULIBC_touch_memory_pool_naive(void) {
-  if ( ULIBC_verbose() > 1 )
-    printf("ULIBC: ULIBC_touch_memory_pool()\n");
-  twalk( __mattr_tree_root, twalk_touch_mattr_node );
-  if ( ULIBC_verbose() > 1 )
-    printf("\n");
+size_t ULIBC_get_interleave_unit(const void *base) {
+  struct mattr_node_t *m = find_mattr( (void *)base );
+  const size_t unit = m ? m->unit : 0;
+  put_mattr(m);
+  return unit;
+}
+
+/* NUMA node of base[offset] in a striped allocation, or -1 if unknown */
+int ULIBC_get_interleave_node(const void *base, size_t offset) {
+  struct mattr_node_t *m = find_mattr( (void *)base );
+  const int node = ( m && m->unit && offset < m->bytes ) ? m->stripe[ (offset / m->unit) % m->nstripe ] : -1;
+  put_mattr(m);
+  return node;
+}
+
+/* ULIBC_MPOL_CHUNK_INTERLEAVE with chunk bytes (0: ULIBC_get_interleave_chunk())
+   over nodemask (NULL: online nodes); NULL if the chunks make too many VMAs */
+void *ULIBC_malloc_chunk_interleave(size_t size, size_t chunk, unsigned long *nodemask) {
+  unsigned long online[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  if ( !nodemask ) {
+    make_nodemask_online(MAX_NODES, online);
+    nodemask = online;
+  }
+  return malloc_explict_stripe(size, ULIBC_MPOL_CHUNK_INTERLEAVE, nodemask, MAX_NODES,
+			       ULIBC_get_page_policy(), chunk);
 }
 
+
 /* --------------------
- * fast touch routines
+ * spill placement
+ *   ULIBC_malloc_bind() checks MemFree of the requested node, and binds
+ *   to the nearest node having MemFree of size + __spill_reserve bytes
+ *   if the node is short. The nodes are ordered by the SLIT distances
+ *   (ULIBC_get_nearest_nodes).
  * -------------------- */
-static int64_t untouched_count;
-static int64_t nnodes;
-static struct mattr_node_t **addr_nodes;
-static int64_t touched_nthrs = 0;
-static pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static void twalk_count_untouched(const void *nodep, const VISIT order, const int level) {
-  (void)level;
-  if ( order != postorder && order != leaf )
-    return;
-  struct mattr_node_t *m = *(struct mattr_node_t **)nodep;
-  if ( ! m->touched )
-    ++untouched_count;
+static long __spill_reserve = -1;	/* -1: disabled */
+
+long ULIBC_get_spill_reserve(void) { return __spill_reserve; }
+void ULIBC_set_spill_reserve(long bytes) { __spill_reserve = MAX(bytes, -1L); }
+
+/* online NUMA node to bind size bytes instead of node */
+static int spill_node(size_t size, int node) {
+  if ( __spill_reserve < 0 || node < 0 || ULIBC_get_online_nodes() <= node )
+    return node;
+  const size_t need = size + __spill_reserve;
+  const int phys = ULIBC_get_online_nodeidx(node);
+  if ( ULIBC_free_memory_size(phys) >= need )
+    return node;
+  
+  /* the nearest node having enough memory, or the node having the most */
+  int order[MAX_NODES], most = node;
+  size_t mostfree = 0;
+  const int n = ULIBC_get_nearest_nodes(node, order);
+  for (int i = 1; i < n; ++i) {
+    const size_t free = ULIBC_free_memory_size( ULIBC_get_online_nodeidx(order[i]) );
+    if ( free >= need )
+      return order[i];
+    if ( free > mostfree ) {
+      most = order[i];
+      mostfree = free;
+    }
+  }
+  return most;
 }
 
-int64_t count_untouched_mattr_node(void) {
-  untouched_count = 0;
-  twalk( __mattr_tree_root, twalk_count_untouched );
-  return untouched_count;
+static void mark_spilled(void *p, int reqnode, int node) {
+  if ( !p || reqnode == node ) return;
+  struct mattr_node_t *m = find_mattr(p);
+  if ( m ) m->reqnode = ULIBC_get_online_nodeidx(reqnode);
+  put_mattr(m);
+  if ( ULIBC_verbose() )
+    printf("ULIBC: spilled %p from NUMA-node %d to %d\n", p,
+	   ULIBC_get_online_nodeidx(reqnode), ULIBC_get_online_nodeidx(node));
+}
+
+/* requested NUMA node of a spilled allocation, or -1 */
+int ULIBC_get_spilled_node(const void *ptr) {
+  struct mattr_node_t *m = find_mattr( (void *)ptr );
+  const int reqnode = m ? m->reqnode : -1;
+  put_mattr(m);
+  return reqnode;
 }
 
-int get_nthrs_from_mattr_node(struct mattr_node_t *m) {
-  if ( !m ) return 0;
+
+/* --------------------
+ * partitioned allocation
+ *   The element range is split into the online NUMA nodes and then
+ *   into their threads by prange(), the same as range() in the
+ *   owner-computes loops. Each node's block is bound to the node along
+ *   the page-aligned boundaries, and the lookups invert prange() in O(1).
+ * -------------------- */
+/* the inverse of prange(len, 0, np, id, ...) */
+static int64_t prange_owner(int64_t len, int64_t np, int64_t i) {
+  const int64_t qt = len / np;
+  const int64_t rm = len % np;
+  if ( i < rm * (qt+1) )
+    return i / (qt+1);
+  else
+    return rm + (i - rm * (qt+1)) / qt;
+}
+
+void *ULIBC_malloc_partitioned(size_t nelems, size_t elemsize, struct ulibc_partition_t *part) {
+  const int nnodes = ULIBC_get_online_nodes();
+  unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  make_nodemask_online(MAX_NODES, nodemask);
+  const size_t bytes = ROUNDUP( MAX(nelems * elemsize, (size_t)1), 1UL << 21 );
+  unsigned char *p = ULIBC_malloc_explict(bytes, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+  if ( !p ) return NULL;
   
-  int nthr = 0;
-  for (unsigned long i = 0; i < m->maxnode; ++i)
-    if ( ISSET_BITMAP( (uint64_t *)m->nodemask, i ) )
-      for (int j = 0; j < ULIBC_get_online_procs(); ++j) {
-      	struct numainfo_t loc = ULIBC_get_numainfo(j);
-      	if ( i == (unsigned long)ULIBC_get_cpuinfo( loc.proc ).node )
-      	  ++nthr;
-      }
-  return nthr;
+  struct mattr_node_t *m = find_mattr(p);
+  const size_t align = ( m && hugetlb_size(m->page) ) ? hugetlb_size(m->page) : (1UL << 12);
+  put_mattr(m);
+  for (int k = 0; k < nnodes; ++k) {
+    long ls, le;
+    prange(nelems, 0, nnodes, k, &ls, &le);
+    const size_t head = ROUNDUP( (size_t)ls * elemsize, align );
+    const size_t tail = ( k == nnodes-1 ) ? bytes : ROUNDUP( (size_t)le * elemsize, align );
+    if ( head >= tail ) continue;
+    unsigned long mask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+    SET_BITMAP( (uint64_t *)mask, ULIBC_get_online_nodeidx(k) );
+    if ( mbind_area(p + head, tail - head, ULIBC_MPOL_BIND, mask, MAX_NODES, 1) && ULIBC_verbose() )
+      printf("ULIBC: cannot bind block %d [%ld, %ld) of %p (errno: %d)\n", k, head, tail, p, errno);
+  }
+  
+  if ( part ) {
+    part->addr     = p;
+    part->nelems   = nelems;
+    part->elemsize = elemsize;
+    part->nnodes   = nnodes;
+  }
+  return p;
+}
+
+/* [ls, le) of the node-th online NUMA node */
+void ULIBC_partition_range(const struct ulibc_partition_t *part, int node, int64_t *ls, int64_t *le) {
+  long s, e;
+  prange(part->nelems, 0, part->nnodes, node, &s, &e);
+  *ls = s;
+  *le = e;
+}
+
+/* online NUMA node index that owns the index-th element */
+int ULIBC_partition_node(const struct ulibc_partition_t *part, size_t index) {
+  return prange_owner(part->nelems, part->nnodes, index);
+}
+
+/* thread index that owns the index-th element; the block of a node is
+   split among the threads which the current mapping places on it, in
+   the order of ULIBC_get_online_thread(), or among all threads if the
+   node has none */
+int ULIBC_partition_thread(const struct ulibc_partition_t *part, size_t index) {
+  const int node = ULIBC_partition_node(part, index);
+  int64_t ls, le;
+  ULIBC_partition_range(part, node, &ls, &le);
+  const struct numainfo_t ni = ULIBC_get_numainfo( ULIBC_get_online_thread(node, 0) );
+  const int nthrs = MIN( ni.lnp, ULIBC_get_online_procs() );
+  if ( ULIBC_get_online_nodes() <= node || ni.node != node || nthrs <= 0 )
+    return prange_owner(part->nelems, ULIBC_get_online_procs(), index);
+  return ULIBC_get_online_thread(node, prange_owner(le-ls, nthrs, index-ls));
+}
+
+/* --------------------
+ * parallel copy
+ *   ULIBC_parallel_memcpy() and ULIBC_parallel_memset() split the
+ *   destination by the policy recorded for it, so that each page is
+ *   written by a thread on its home node. Interleaved and striped
+ *   allocations are split into pieces (pages or stripe units), whose
+ *   home nodes follow the round of the policy; the other allocations
+ *   are split contiguously among the threads of their nodemask, or of
+ *   all nodes if they are not bound. Large ranges are written by
+ *   non-temporal stores, which do not pollute the caches.
+ * -------------------- */
+#ifndef PCOPY_MIN_BYTES
+#define PCOPY_MIN_BYTES (1UL << 20)
+#endif
+#ifndef PCOPY_STREAM_BYTES
+#define PCOPY_STREAM_BYTES (1UL << 23)
+#endif
+
+enum { PCOPY_COPY, PCOPY_SET, PCOPY_TOUCH };
+
+struct pcopy_plan_t {
+  int op, c, stream;
+  unsigned char *dst;
+  const unsigned char *src;
+  size_t bytes;
+  uintptr_t base;			/* address of the first piece */
+  size_t unit;				/* bytes per piece (0: contiguous) */
+  int nstripe;				/* #pieces per round */
+  unsigned char stripe[MATTR_MAX_STRIPE]; /* home node of each piece */
+};
+
+struct pcopy_arg_t {
+  int tid, rank, nthrs, node;
+  const struct pcopy_plan_t *plan;
+};
+
+/* orders the non-temporal stores of this thread */
+static void stream_fence(void) {
+#if defined(__SSE2__)
+  _mm_sfence();
+#endif
 }
 
-static void twalk_count_untouched_numa(const void *nodep, const VISIT order, const int level) {
-  (void)level;
-  if ( order == postorder || order == leaf ) {
-    struct mattr_node_t *m = *(struct mattr_node_t **)nodep;
-    if ( ! m->touched )
-      addr_nodes[ nnodes++ ] = m;
+static void stream_copy(unsigned char *dst, const unsigned char *src, size_t n) {
+#if defined(__SSE2__)
+  const size_t head = MIN( n, (16 - ((uintptr_t)dst & 15)) & 15 );
+  memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  for ( ; n >= 64; n -= 64, dst += 64, src += 64) {
+    const __m128i x0 = _mm_loadu_si128( (const __m128i *)src + 0 );
+    const __m128i x1 = _mm_loadu_si128( (const __m128i *)src + 1 );
+    const __m128i x2 = _mm_loadu_si128( (const __m128i *)src + 2 );
+    const __m128i x3 = _mm_loadu_si128( (const __m128i *)src + 3 );
+    _mm_stream_si128( (__m128i *)dst + 0, x0 );
+    _mm_stream_si128( (__m128i *)dst + 1, x1 );
+    _mm_stream_si128( (__m128i *)dst + 2, x2 );
+    _mm_stream_si128( (__m128i *)dst + 3, x3 );
   }
+#endif
+  memcpy(dst, src, n);
 }
 
-static void *pth_touch(void *arg) {
-  struct numainfo_t loc = ULIBC_get_numainfo( ULIBC_get_thread_num() );
-  struct cpuinfo_t topo = ULIBC_get_cpuinfo( loc.proc );
+static void stream_set(unsigned char *dst, int c, size_t n) {
+#if defined(__SSE2__)
+  const size_t head = MIN( n, (16 - ((uintptr_t)dst & 15)) & 15 );
+  memset(dst, c, head);
+  dst += head, n -= head;
+  const __m128i x = _mm_set1_epi8( (char)c );
+  for ( ; n >= 64; n -= 64, dst += 64) {
+    _mm_stream_si128( (__m128i *)dst + 0, x );
+    _mm_stream_si128( (__m128i *)dst + 1, x );
+    _mm_stream_si128( (__m128i *)dst + 2, x );
+    _mm_stream_si128( (__m128i *)dst + 3, x );
+  }
+#endif
+  memset(dst, c, n);
+}
 
-  for (int i = 0; i < untouched_count; ++i) {
-    struct mattr_node_t *m = addr_nodes[i];
-    
-    if ( ULIBC_get_thread_num() == 0 )
-      touched_nthrs = 0;
-    
-    ULIBC_hierarchical_barrier();
-    
-    if ( ISSET_BITMAP(m->nodemask, topo.node) ) {
-      const int corr_thrid = fetch_and_add_int64(&touched_nthrs, 1);
-      const int corr_nthrs = get_nthrs_from_mattr_node( m );
-      
-      if ( ULIBC_verbose() > 2 ) {
-	pthread_mutex_lock(&print_mutex);
-	printf("[%02d] [ Thread: %3d of %d (Proc: %3d, Socket: %2d) ] ",
-	       i, ULIBC_get_thread_num(), ULIBC_get_num_threads(), topo.id, topo.node);
-	printf("addr: %p, size: %ld bytes, ", m->addr, m->bytes);
-	printf("nodemask: "); show_bitmap( ULIBC_get_num_nodes(), m->nodemask );
-	printf(", Lthr: %3d of %3d \n", corr_thrid, corr_nthrs);
-	pthread_mutex_unlock(&print_mutex);
-      }
-      
-      unsigned char *p = m->addr;
-      long ls, le;
-      prange(m->bytes, 0, corr_nthrs, corr_thrid, &ls, &le);
-      touch_seq( &p[ls], le-ls );
-      
-      if ( corr_thrid == 0 )
-	m->touched = 1;
+/* writes [off, off+len) of the plan */
+static void pcopy_range(const struct pcopy_plan_t *pl, size_t off, size_t len) {
+  unsigned char *dst = pl->dst + off;
+  switch (pl->op) {
+  case PCOPY_COPY:
+    if ( pl->stream ) stream_copy(dst, pl->src + off, len);
+    else              memcpy(dst, pl->src + off, len);
+    break;
+  case PCOPY_SET:
+    if ( pl->stream ) stream_set(dst, pl->c, len);
+    else              memset(dst, pl->c, len);
+    break;
+  case PCOPY_TOUCH:
+    /* pages of a new mapping are zero-filled by the kernel */
+    if ( ULIBC_get_touch_policy() == ULIBC_TOUCH_POPULATE ) {
+      touch_populate(dst, len);
+    } else {
+      const size_t pagesz = 1UL << 12;
+      for (size_t k = 0; k < len; k += pagesz)
+	dst[k] = 0;
     }
-    ULIBC_hierarchical_barrier();
-    
-    if ( ULIBC_verbose() > 1 ) {
-      if ( m->touched && ULIBC_get_thread_num() == 0 ) {
-	printf("ULIBC: [%2d] touched ", ULIBC_get_thread_num());
-	print_mattr_node( m );
-	printf("\n");
-      }
+    break;
+  }
+}
+
+/* writes the [ls, le)-th pieces homed on node; returns #pieces homed on node */
+static long pcopy_node_pieces(const struct pcopy_plan_t *pl, int node, long ls, long le) {
+  long count = 0;
+  size_t u = ((uintptr_t)pl->dst - pl->base) / pl->unit;
+  for (size_t off = 0; off < pl->bytes; ++u) {
+    const size_t next = MIN( pl->base + (u+1) * pl->unit - (uintptr_t)pl->dst, pl->bytes );
+    if ( pl->stripe[u % pl->nstripe] == node ) {
+      if ( ls <= count && count < le )
+	pcopy_range(pl, off, next - off);
+      ++count;
     }
-    
-    ULIBC_hierarchical_barrier();
+    off = next;
+  }
+  return count;
+}
+
+static void *pth_pcopy(void *arg) {
+  const struct pcopy_arg_t *a = arg;
+  const struct pcopy_plan_t *pl = a->plan;
+  ULIBC_bind_thread_explicit(a->tid);
+  
+  long ls, le;
+  if ( pl->unit == 0 ) {
+    const size_t pagesz = 1UL << 12;
+    prange(ROUNDUP(pl->bytes, pagesz) / pagesz, 0, a->nthrs, a->rank, &ls, &le);
+    if ( ls < le )
+      pcopy_range(pl, ls * pagesz, MIN( (size_t)le * pagesz, pl->bytes ) - ls * pagesz);
+  } else {
+    /* the rank-th share of the pieces homed on this node */
+    prange(pcopy_node_pieces(pl, a->node, 0, 0), 0, a->nthrs, a->rank, &ls, &le);
+    pcopy_node_pieces(pl, a->node, ls, le);
   }
+  if ( pl->stream ) stream_fence();
   return arg;
 }
 
-void ULIBC_touch_memory_pool(void) {
-  const int64_t untouched_count = count_untouched_mattr_node();
+/* home nodes of dst by its recorded policy; returns 0 if split contiguously */
+static int pcopy_pieces(struct pcopy_plan_t *pl, const struct mattr_node_t *m) {
+  if ( m->unit ) {
+    pl->base = (uintptr_t)m->addr;
+    pl->unit = m->unit;
+    pl->nstripe = m->nstripe;
+    memcpy( pl->stripe, m->stripe, m->nstripe );
+    return 1;
+  }
+  if ( m->mpol != get_mempol_mode(ULIBC_MPOL_INTERLEAVE) )
+    return 0;
   
-  addr_nodes = malloc( sizeof(struct mattr_node_t *) * untouched_count );
-  /* printf("ULIBC: Number of untouched entries: %" PRId64 "\n", untouched_count); */
-  nnodes = 0;
-  twalk( __mattr_tree_root, twalk_count_untouched_numa );
-  assert( nnodes == untouched_count );
+  /* the kernel interleaves pages by their index */
+  pl->nstripe = 0;
+  for (unsigned long k = 0; k < MIN(m->maxnode, (unsigned long)MAX_NODES); ++k) {
+    if ( !ISSET_BITMAP( (uint64_t *)m->nodemask, k ) ) continue;
+    if ( pl->nstripe == MATTR_MAX_STRIPE ) return 0;
+    pl->stripe[pl->nstripe++] = k;
+  }
+  if ( pl->nstripe == 0 ) return 0;
+  pl->base = 0;
+  pl->unit = hugetlb_size(m->page) ? hugetlb_size(m->page) :
+    ( m->page == ULIBC_PAGE_THP ? (1UL << 21) : (1UL << 12) );
+  return 1;
+}
+
+/* writes pl->dst within the mapping m (NULL: none), and unpins m */
+static void parallel_piece(struct pcopy_plan_t *pl, struct mattr_node_t *m) {
+  const int nprocs = ULIBC_get_online_procs();
+  if ( m ) wait_async_touch(m);
+  pl->unit = 0;
+  if ( pl->bytes < PCOPY_MIN_BYTES || nprocs <= 1 ) {
+    put_mattr(m);
+    pcopy_range(pl, 0, pl->bytes);
+    if ( pl->stream ) stream_fence();
+    return;
+  }
   
-  printf("\n");
+  /* threads on the home nodes */
+  int tids[MAX_CPUS], nthrs = 0, nodethrs[MAX_NODES] = {0};
+  if ( m && pcopy_pieces(pl, m) ) {
+    for (int i = 0; i < nprocs; ++i)
+      ++nodethrs[ touch_thread_node(i) ];
+    for (int s = 0; s < pl->nstripe; ++s)
+      if ( nodethrs[ pl->stripe[s] ] == 0 ) pl->unit = 0;
+  }
+  if ( pl->unit ) {
+    for (int i = 0; i < nprocs; ++i) tids[nthrs++] = i;
+  } else if ( m && m->mpol != get_mempol_mode(ULIBC_MPOL_DEFAULT) &&
+	      m->mpol != get_mempol_mode(ULIBC_MPOL_LOCAL) ) {
+    nthrs = nodemask_threads((unsigned long *)m->nodemask,
+			     MIN(m->maxnode, (unsigned long)MAX_NODES), tids);
+  }
+  if ( nthrs == 0 ) {
+    for (int i = 0; i < nprocs; ++i) tids[nthrs++] = i;
+  }
+  put_mattr(m);
   
+  struct pcopy_arg_t *args = malloc( sizeof(struct pcopy_arg_t) * nthrs );
   pthread_t pth[MAX_CPUS];
-  if ( ULIBC_verbose() > 1 )
-    printf("ULIBC: ULIBC_touch_memory_pool() with %d posix threads\n",
-	   ULIBC_get_online_procs());
-  
-  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
-    pthread_create( &pth[i], NULL, pth_touch, NULL );
+  int rank[MAX_NODES] = {0};
+  for (int i = 0; i < nthrs; ++i) {
+    const int node = touch_thread_node(tids[i]);
+    args[i].tid   = tids[i];
+    args[i].node  = node;
+    args[i].rank  = pl->unit ? rank[node]++ : i;
+    args[i].nthrs = pl->unit ? nodethrs[node] : nthrs;
+    args[i].plan  = pl;
+    pthread_create( &pth[i], NULL, pth_pcopy, &args[i] );
   }
-  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
+  for (int i = 0; i < nthrs; ++i)
     pthread_join( pth[i], NULL );
-  }
-  ULIBC_clear_thread_num();
+  free(args);
   
-  /* naive */
-  ULIBC_touch_memory_pool_naive();
-  free(addr_nodes);
+  if ( ULIBC_verbose() > 2 )
+    printf("ULIBC: parallel %s %p (%ld bytes) with %d threads by %s\n",
+	   (const char *[]){ "memcpy", "memset", "touch" }[pl->op], pl->dst, pl->bytes, nthrs,
+	   pl->unit ? "pieces" : "ranges");
+}
+
+/* splits [dst, dst+bytes) at the ends of the registered mappings, each
+   of which is written by its own policy; the rest from an unregistered
+   address is split evenly among all threads */
+static void parallel_area(struct pcopy_plan_t *pl) {
+  const int stream = ( pl->bytes >= PCOPY_STREAM_BYTES );
+  for (size_t off = 0; off < pl->bytes; ) {
+    struct pcopy_plan_t piece = *pl;
+    piece.dst = pl->dst + off;
+    piece.src = pl->src ? pl->src + off : NULL;
+    piece.bytes = pl->bytes - off;
+    piece.stream = stream;
+    struct mattr_node_t *m = find_mattr_range(piece.dst);
+    if ( m )
+      piece.bytes = MIN( piece.bytes, (uintptr_t)m->addr + m->bytes - (uintptr_t)piece.dst );
+    parallel_piece(&piece, m);
+    off += piece.bytes;
+  }
+}
+
+void *ULIBC_parallel_memcpy(void *dst, const void *src, size_t n) {
+  struct pcopy_plan_t pl = { .op = PCOPY_COPY, .dst = dst, .src = src, .bytes = n };
+  parallel_area(&pl);
+  return dst;
+}
+
+void *ULIBC_parallel_memset(void *dst, int c, size_t n) {
+  struct pcopy_plan_t pl = { .op = PCOPY_SET, .dst = dst, .c = c, .bytes = n };
+  parallel_area(&pl);
+  return dst;
+}
+
+/* zeros a new allocation; untouched mappings are only touched on their home nodes */
+static void *calloc_zero(void *p, size_t size) {
+  if ( !p ) return NULL;
+  struct mattr_node_t *m = find_mattr(p);
+  if ( m ) wait_async_touch(m);
+  if ( m && !m->touched ) {
+    struct pcopy_plan_t pl = { .op = PCOPY_TOUCH, .dst = p, .bytes = m->bytes };
+    STATS_TIMED( STATS_TOUCH, parallel_area(&pl) );
+    m->touched = 1;
+    stats_place(m);
+  } else {
+    ULIBC_parallel_memset(p, 0, size);
+  }
+  put_mattr(m);
+  return p;
+}
+
+void *ULIBC_calloc_explict(size_t nmemb, size_t size, int mpol, unsigned long *nodemask, unsigned long maxnode) {
+  if ( size && nmemb > SIZE_MAX / size ) return NULL;
+  return calloc_zero( ULIBC_malloc_explict(nmemb * size, mpol, nodemask, maxnode), nmemb * size );
+}
+
+void *ULIBC_calloc_mempol(size_t nmemb, size_t size, int mpol) {
+  if ( size && nmemb > SIZE_MAX / size ) return NULL;
+  return calloc_zero( ULIBC_malloc_mempol(nmemb * size, mpol), nmemb * size );
+}
+
+void *ULIBC_calloc_bind(size_t nmemb, size_t size, int node) {
+  if ( size && nmemb > SIZE_MAX / size ) return NULL;
+  return calloc_zero( ULIBC_malloc_bind(nmemb * size, node), nmemb * size );
+}
+
+void *ULIBC_calloc_interleave(size_t nmemb, size_t size) {
+  if ( size && nmemb > SIZE_MAX / size ) return NULL;
+  return calloc_zero( ULIBC_malloc_interleave(nmemb * size), nmemb * size );
 }
 
 
 /* --------------------
- * memory usages
+ * memory-mapped files
+ *   The page cache is allocated by the reading thread, so the prefault
+ *   runs on the threads of the nodes in nodemask; each of them reads
+ *   ahead (MADV_WILLNEED) and faults its contiguous share by reads.
+ *   A file mapping holds the file contents, so it is registered as
+ *   touched and the pool touchers never write to it.
  * -------------------- */
-size_t __usage[MAX_NODES];
+struct prefault_arg_t {
+  int tid, rank, nthrs;
+  unsigned char *addr;
+  size_t bytes;
+};
 
-static void twalk_memory_usage(const void *nodep, const VISIT order, const int level) {
-  (void)level;
-  if ( order != postorder && order != leaf )
-    return;
+static void *pth_prefault(void *arg) {
+  struct prefault_arg_t *a = arg;
+  const size_t pagesz = 1UL << 12;
+  if ( a->tid >= 0 )
+    ULIBC_bind_thread_explicit(a->tid);
+  
+  long ls, le;
+  prange(ROUNDUP(a->bytes, pagesz) / pagesz, 0, a->nthrs, a->rank, &ls, &le);
+  if ( ls < le ) {
+    const size_t head = ls * pagesz, tail = MIN( (size_t)le * pagesz, a->bytes );
+    madvise(a->addr + head, tail - head, MADV_WILLNEED);
+    volatile unsigned char sum = 0;
+    for (size_t k = head; k < tail; k += pagesz)
+      sum += a->addr[k];
+    (void)sum;
+  }
+  return arg;
+}
+
+static void prefault_area(unsigned char *addr, size_t bytes, unsigned long *nodemask, unsigned long maxnode) {
+  int tids[MAX_CPUS];
+  const int nthrs = nodemask_threads(nodemask, maxnode, tids);
+  struct prefault_arg_t *args = malloc( sizeof(struct prefault_arg_t) * (nthrs+1) );
+  if ( nthrs == 0 ) {
+    args[0] = (struct prefault_arg_t){ .tid = -1, .rank = 0, .nthrs = 1, .addr = addr, .bytes = bytes };
+    pth_prefault(&args[0]);
+  } else {
+    pthread_t pth[MAX_CPUS];
+    for (int i = 0; i < nthrs; ++i) {
+      args[i] = (struct prefault_arg_t){ .tid = tids[i], .rank = i, .nthrs = nthrs, .addr = addr, .bytes = bytes };
+      pthread_create( &pth[i], NULL, pth_prefault, &args[i] );
+    }
+    for (int i = 0; i < nthrs; ++i)
+      pthread_join( pth[i], NULL );
+  }
+  free(args);
+}
+
+void *ULIBC_mmap_file(const char *path, size_t offset, size_t len, int mpol,
+		      unsigned long *nodemask, int flags) {
+  if ( offset % (1UL << 12) ) {
+    printf("ULIBC: ULIBC_mmap_file(%s): offset %ld is not page-aligned\n", path, offset);
+    return NULL;
+  }
+  const int fd = open(path, (flags & ULIBC_MMAP_SHARED) ? O_RDWR : O_RDONLY);
+  if ( fd < 0 ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot open %s (errno: %d)\n", path, errno);
+    return NULL;
+  }
+  /* pages past the end of the file raise SIGBUS when they are accessed */
+  struct stat st;
+  const size_t fsize = fstat(fd, &st) ? 0 : (size_t)st.st_size;
+  if ( len == 0 && fsize > offset )
+    len = fsize - offset;
+  if ( offset > fsize || len > fsize - offset ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: [%ld, %ld) is beyond the end of %s (%ld bytes)\n", offset, offset + len, path, fsize);
+    close(fd);
+    return NULL;
+  }
+  void *p = MAP_FAILED;
+  if ( len > 0 )
+    STATS_TIMED( STATS_MMAP, p = mmap(0, len, (PROT_READ | PROT_WRITE),
+				      (flags & ULIBC_MMAP_SHARED) ? MAP_SHARED : MAP_PRIVATE, fd, offset) );
+  close(fd);
+  if ( p == MAP_FAILED ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot map %s (errno: %d)\n", path, errno);
+    return NULL;
+  }
+  
+  unsigned long online[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  if ( !nodemask ) {
+    make_nodemask_online(MAX_NODES, online);
+    nodemask = online;
+  }
+  if ( mbind_area(p, len, mpol, nodemask, MAX_NODES, 0) ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot bind %s (errno: %d), uses default policy\n", path, errno);
+    mpol = ULIBC_MPOL_DEFAULT;
+  }
+  madvise(p, len, MADV_SEQUENTIAL);
   
-  struct mattr_node_t *m = *(struct mattr_node_t **)nodep;
+  struct mattr_node_t *m = insert_mattr( len, p );
+  m->touched = 1;
+  m->routine = ULIBC_MMAP_FILE;
+  m->mpol    = get_mempol_mode(mpol);
+  m->page    = ULIBC_PAGE_DEFAULT;
+  m->maxnode = MAX_NODES;
+  memcpy( m->nodemask, nodemask, sizeof(m->nodemask) );
+  if ( is_striped_mpol(mpol) )
+    stripe_mattr_node(m, mpol, nodemask, MAX_NODES, 0);
+  stats_alloc(m, mpol);
   
-  int ell = 0;
-  for (unsigned long i = 0; i < m->maxnode; ++i) {
-    if ( ISSET_BITMAP( (uint64_t *)m->nodemask, i ) )
-      ++ell;
+  if ( flags & ULIBC_MMAP_PREFAULT ) {
+    STATS_TIMED( STATS_TOUCH, prefault_area(p, len, nodemask, MAX_NODES) );
+    stats_place(m);
   }
-  for (unsigned long i = 0; i < m->maxnode; ++i) {
-    if ( ISSET_BITMAP( (uint64_t *)m->nodemask, i ) )
-      __usage[i] += m->bytes / ell + 1;
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: map %s ", path);
+    print_mattr_node( m );
+    printf("\n");
   }
+  return p;
 }
 
-size_t ULIBC_memory_usage_node(unsigned long maxnode, size_t *usage) {
-  for (unsigned long i = 0; i < MAX_NODES; ++i) {
-    __usage[i] = 0;
+/* changes the policy of the allocation containing ptr and moves its pages */
+int ULIBC_rebind(void *ptr, int mpol, unsigned long *nodemask) {
+  struct mattr_node_t *m = find_mattr_range(ptr);
+  if ( !m ) return -1;
+  int err;
+  if ( is_striped_mpol(mpol) ) {
+    /* stripes are bound run by run, which moves their resident pages */
+    m->unit = 0;
+    err = stripe_mattr_node(m, mpol, nodemask, MAX_NODES, 0);
+    if ( err ) {
+      m->unit = 0;
+      m->nstripe = 0;
+    }
+  } else {
+    err = migrate_area(m->addr, m->bytes, mpol, nodemask, MAX_NODES);
   }
-  twalk( __mattr_tree_root, twalk_memory_usage );
-  if (usage) {
-    for (unsigned long i = 0; i < maxnode; ++i)
-      usage[i] = __usage[i];
+  if ( !err )
+    update_mattr_policy(m->addr, m->bytes, mpol, nodemask, MAX_NODES);
+  put_mattr(m);
+  return err ? -1 : 0;
+}
+
+/* --------------------
+ * shared memory segments
+ *   A segment is a POSIX shared memory object, or an anonymous memfd
+ *   inherited by fork() if name is NULL. The policy applied to a
+ *   shared mapping is kept by the object itself, so that its pages
+ *   follow the creator's policy whichever process faults them. The
+ *   creator first-touches the segment like ULIBC_malloc_*(), whereas
+ *   attached segments are registered as touched and never touched,
+ *   which keeps their contents. An attacher may replace the policy of
+ *   the object for the pages faulted later, stripes included.
+ * -------------------- */
+static struct mattr_node_t *insert_shm_mattr(void *p, size_t size, int mpol,
+					     unsigned long *nodemask, int touched) {
+  struct mattr_node_t *m = insert_mattr( size, p );
+  m->touched = touched;
+  m->routine = ULIBC_MMAP_SHM;
+  m->mpol    = get_mempol_mode(mpol);
+  m->page    = ULIBC_PAGE_DEFAULT;
+  m->maxnode = MAX_NODES;
+  if ( nodemask )
+    memcpy( m->nodemask, nodemask, sizeof(m->nodemask) );
+  return m;
+}
+
+void *ULIBC_shm_create(const char *name, size_t size, int mpol, unsigned long *nodemask) {
+  if ( size == 0 ) return NULL;
+  size = ROUNDUP(size, 1UL << 12);
+  int fd = -1;
+  if ( name ) {
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  } else {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    fd = syscall(SYS_memfd_create, "ulibc", 0);
+#endif
   }
-  size_t total = 0;
-  for (unsigned long i = 0; i < MAX_NODES; ++i) {
-    total += __usage[i];
+  if ( fd < 0 ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot create shared memory %s (errno: %d)\n", name ? name : "(memfd)", errno);
+    return NULL;
   }
-  return total;
+  void *p = MAP_FAILED;
+  if ( !ftruncate(fd, size) )
+    STATS_TIMED( STATS_MMAP, p = mmap(0, size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0) );
+  close(fd);
+  if ( p == MAP_FAILED ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot map shared memory %s (errno: %d)\n", name ? name : "(memfd)", errno);
+    if ( name ) shm_unlink(name);
+    return NULL;
+  }
+  
+  unsigned long online[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  if ( !nodemask ) {
+    make_nodemask_online(MAX_NODES, online);
+    nodemask = online;
+  }
+  if ( mbind_area(p, size, mpol, nodemask, MAX_NODES, 0) ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot bind shared memory %s (errno: %d), uses default policy\n",
+	     name ? name : "(memfd)", errno);
+    mpol = ULIBC_MPOL_DEFAULT;
+  }
+  
+  struct mattr_node_t *m = insert_shm_mattr(p, size, mpol, nodemask, 0);
+  if ( is_striped_mpol(mpol) )
+    stripe_mattr_node(m, mpol, nodemask, MAX_NODES, 0);
+  stats_alloc(m, mpol);
+  async_touch_new(m);
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: create shared memory %s ", name ? name : "(memfd)");
+    print_mattr_node( m );
+    printf("\n");
+  }
+  return p;
 }
 
-size_t ULIBC_memory_usage(void) {
-  return ULIBC_memory_usage_node(0, NULL);
+/* size of the segment name in bytes, or 0 */
+size_t ULIBC_shm_size(const char *name) {
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if ( fd < 0 ) return 0;
+  struct stat st;
+  const size_t size = fstat(fd, &st) ? 0 : (size_t)st.st_size;
+  close(fd);
+  return size;
+}
+
+/* maps size bytes (0: whole segment) of name; mpol other than
+   ULIBC_MPOL_DEFAULT replaces the policy of the object for new pages */
+void *ULIBC_shm_attach(const char *name, size_t size, int mpol, unsigned long *nodemask) {
+  const int fd = shm_open(name, O_RDWR, 0);
+  if ( fd < 0 ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot open shared memory %s (errno: %d)\n", name, errno);
+    return NULL;
+  }
+  struct stat st;
+  if ( size == 0 && !fstat(fd, &st) )
+    size = st.st_size;
+  void *p = MAP_FAILED;
+  if ( size > 0 )
+    STATS_TIMED( STATS_MMAP, p = mmap(0, size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0) );
+  close(fd);
+  if ( p == MAP_FAILED ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot map shared memory %s (errno: %d)\n", name, errno);
+    return NULL;
+  }
+  
+  unsigned long online[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  if ( !nodemask ) {
+    make_nodemask_online(MAX_NODES, online);
+    nodemask = online;
+  }
+  if ( mpol != ULIBC_MPOL_DEFAULT && mbind_area(p, size, mpol, nodemask, MAX_NODES, 0) ) {
+    if ( ULIBC_verbose() )
+      printf("ULIBC: cannot bind shared memory %s (errno: %d), keeps its policy\n", name, errno);
+    mpol = ULIBC_MPOL_DEFAULT;
+  }
+  
+  struct mattr_node_t *m = insert_shm_mattr(p, size, mpol, nodemask, 1);
+  if ( is_striped_mpol(mpol) )
+    stripe_mattr_node(m, mpol, nodemask, MAX_NODES, 0);
+  stats_alloc(m, mpol);
+  stats_place(m);
+  
+  if ( ULIBC_verbose() > 1 ) {
+    printf("ULIBC: attach shared memory %s ", name);
+    print_mattr_node( m );
+    printf("\n");
+  }
+  return p;
+}
+
+/* removes the name; attached mappings remain until ULIBC_free() */
+int ULIBC_shm_unlink(const char *name) {
+  return shm_unlink(name);
 }
 
 
@@ -262,8 +2367,6 @@ size_t ULIBC_memory_usage(void) {
  * NUMA_finalize
  * ------------------------------------------------------------ */
 void ULIBC_finalize(void) {
+  dump_alloc_stats();
   ULIBC_all_free();
-#if __gnu_linux__
-  tdestroy( __mattr_tree_root, free );
-#endif
 }
@@ -35,6 +35,14 @@ static int __online_procs;
 static int __online_nodes;
 static int __online_ncores_on_node[MAX_NODES];
 static int __online_nodelist[MAX_NODES];
+static int __online_threadbase[MAX_NODES];	/* offset of node's threads in __online_threadlist */
+static int __online_threadlist[MAX_CPUS];	/* thread indices sorted by (node, core) */
+static int __online_llcs;
+static int __online_ncores_on_llc[MAX_CPUS];
+static int __online_llc_threadbase[MAX_CPUS];	/* offset of LLC's threads in __online_llc_threadlist */
+static int __online_llc_threadlist[MAX_CPUS];	/* thread indices sorted by (llc, llc_core) */
+static int __llc_rank[MAX_CPUS];		/* LLC index in its node, by processor */
+static int __llc_core_rank[MAX_CPUS];		/* core index in its LLC, by processor */
 struct numainfo_t __numainfo[MAX_CPUS];
 
 static void get_sorted_procs(int *sorted_proc);
@@ -57,9 +65,11 @@ int ULIBC_init_numa_mapping(void) {
       if      ( !strcmp(affi_name, "external") ) __use_affinity   = SCHED_AFFINITY;
       else if ( !strcmp(affi_name, "scatter")  ) { __use_affinity = ULIBC_AFFINITY; __mapping_policy = SCATTER_MAPPING; }
       else if ( !strcmp(affi_name, "compact")  ) { __use_affinity = ULIBC_AFFINITY; __mapping_policy = COMPACT_MAPPING; }
+      else if ( !strcmp(affi_name, "capacity_scatter") ) { __use_affinity = ULIBC_AFFINITY; __mapping_policy = CAPACITY_SCATTER_MAPPING; }
+      else if ( !strcmp(affi_name, "capacity_compact") ) { __use_affinity = ULIBC_AFFINITY; __mapping_policy = CAPACITY_COMPACT_MAPPING; }
       else {
 	printf("Unkrown affinity policy '%s'.\n"
-	       "    ULIBC supports 'scatter' or 'compact'.\n", affi_name);
+	       "    ULIBC supports 'scatter', 'compact', 'capacity_scatter', or 'capacity_compact'.\n", affi_name);
 	exit(1);
       }
     }
@@ -68,9 +78,10 @@ int ULIBC_init_numa_mapping(void) {
       else if ( !strcmp(bind_name, "fine")   ) __binding_policy = THREAD_TO_THREAD;
       else if ( !strcmp(bind_name, "core")   ) __binding_policy = THREAD_TO_CORE;
       else if ( !strcmp(bind_name, "socket") ) __binding_policy = THREAD_TO_SOCKET;
+      else if ( !strcmp(bind_name, "llc")    ) __binding_policy = THREAD_TO_LLC;
       else {
 	printf("Unkrown binding policy '%s'.\n"
-	       "    ULIBC supports 'thread' ('fine'), 'core', or 'socket'.\n", bind_name);
+	       "    ULIBC supports 'thread' ('fine'), 'core', 'llc', or 'socket'.\n", bind_name);
 	exit(1);
       }
     }
@@ -119,8 +130,9 @@ int ULIBC_init_numa_mapping(void) {
     for (int i = 0; i < ULIBC_get_max_online_procs(); ++i) {
       const int idx = proc_list[i];
       struct cpuinfo_t ci = ULIBC_get_cpuinfo(idx);
-      printf("ULIBC: Online CPU[%03d] Processor: %3d, Package: %2d, Core: %2d, SMT: %2d\n",
-	     idx, ci.id, ci.node, ci.core, ci.smt);
+      printf("ULIBC: Online CPU[%03d] Processor: %3d, Package: %2d, Core: %2d, SMT: %2d, %s-core (%4d)\n",
+	     idx, ci.id, ci.node, ci.core, ci.smt,
+	     ci.type == ULIBC_CORE_EFFICIENCY ? "E" : "P", ci.capacity);
     }
   }
   
@@ -167,6 +179,8 @@ const char *ULIBC_get_current_mapping_name(void) {
       switch ( ULIBC_get_current_mapping() ) {
       case SCATTER_MAPPING: return "scatter";
       case COMPACT_MAPPING: return "compact";
+      case CAPACITY_SCATTER_MAPPING: return "capacity_scatter";
+      case CAPACITY_COMPACT_MAPPING: return "capacity_compact";
       default:              return "unknown";
       }
       
@@ -189,6 +203,7 @@ const char *ULIBC_get_current_binding_name(void) {
       case THREAD_TO_THREAD: return "thread";
       case THREAD_TO_CORE:   return "core";
       case THREAD_TO_SOCKET: return "socket";
+      case THREAD_TO_LLC:    return "llc";
       default:               return "unknown";
       }
       
@@ -212,6 +227,58 @@ int ULIBC_get_online_nodeidx(int node) {
     node %= ULIBC_get_online_nodes();
   return __online_nodelist[node];
 }
+int ULIBC_get_online_thread(int node, int core) {
+  if ( !ULIBC_enable_numa_mapping() )
+    return core;
+  return __online_threadlist[ __online_threadbase[node] + core ];
+}
+
+/* online NUMA nodes in order of the SLIT distance from node, which comes
+   first; equidistant nodes follow node cyclically. returns #online nodes */
+int ULIBC_get_nearest_nodes(int node, int *order) {
+  const int n = ULIBC_get_online_nodes();
+  if ( node < 0 || n <= node ) return 0;
+  const int from = ULIBC_get_online_nodeidx(node);
+  int dist[MAX_NODES];
+  for (int i = 0; i < n; ++i) {
+    order[i] = (node + i) % n;
+    dist[i] = ULIBC_get_node_distance(from, ULIBC_get_online_nodeidx(order[i]));
+  }
+  /* stable insertion sort from order[1] */
+  for (int i = 2; i < n; ++i) {
+    const int o = order[i], d = dist[i];
+    int j = i;
+    for ( ; j > 1 && dist[j-1] > d; --j) {
+      order[j] = order[j-1];
+      dist[j] = dist[j-1];
+    }
+    order[j] = o;
+    dist[j] = d;
+  }
+  return n;
+}
+
+/* online threads sharing the level cache (0: last level) with thread tid,
+   which is included; returns #threads */
+int ULIBC_get_cache_threads(int level, int tid, int *tids) {
+  if ( level <= 0 ) level = ULIBC_get_cache_levels();
+  const int leader = ULIBC_get_cache_info(level, ULIBC_get_numainfo(tid).proc).leader;
+  int n = 0;
+  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
+    if ( i == tid ||
+	 ( leader >= 0 && ULIBC_get_cache_info(level, ULIBC_get_numainfo(i).proc).leader == leader ) )
+      tids[n++] = i;
+  }
+  return n;
+}
+
+int ULIBC_get_online_llcs(void) { return __online_llcs; }
+int ULIBC_get_online_llc_cores(int llc) { return __online_ncores_on_llc[llc]; }
+int ULIBC_get_online_llc_thread(int llc, int core) {
+  if ( !ULIBC_enable_numa_mapping() )
+    return core;
+  return __online_llc_threadlist[ __online_llc_threadbase[llc] + core ];
+}
 
 int ULIBC_get_num_threads(void) {
   return __online_procs;
@@ -243,7 +310,7 @@ struct numainfo_t ULIBC_get_numainfo(int tid) {
   if ( !ULIBC_enable_numa_mapping() || tid < 0 ) {
     return (struct numainfo_t){
       .id = tid, .proc = tid, .node = 0, .core = tid,
-	.lnp = ULIBC_get_max_online_procs() };
+	.lnp = ULIBC_get_max_online_procs(), .llc = 0, .llc_core = tid };
   } else {
     return __numainfo[tid];
   }
@@ -293,6 +360,14 @@ void ULIBC_print_mapping(FILE *fp) {
     fprintf(fp, "ULIBC: NUMA-node %3d has %2d NUMA-cores    { %s }\n",
   	    k, ULIBC_get_online_cores(k), bind_str);
   }
+  for (int l = 0; l < ULIBC_get_online_llcs(); ++l) {
+    const int head = ULIBC_get_online_llc_thread(l, 0);
+    fprintf(fp, "ULIBC: LLC %03d on NUMA %03d has %d LLC-threads = { ",
+	    l, ULIBC_get_numainfo(head).node, ULIBC_get_online_llc_cores(l));
+    for (int c = 0; c < ULIBC_get_online_llc_cores(l); ++c)
+      fprintf(fp, "%d ", ULIBC_get_online_llc_thread(l, c));
+    fprintf(fp, "}\n");
+  }
 }
 
 
@@ -300,8 +375,8 @@ void ULIBC_print_thread_mapping(FILE *fp) {
   if (!fp) return;
   for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
     struct numainfo_t ni = ULIBC_get_numainfo(i);
-    fprintf(fp, "ULIBC: OpenMP Thread %3d, NUMA: %3d, LCore: %2d, #LCores, %2d\n",
-	    ni.id, ni.node, ni.core, ni.lnp);
+    fprintf(fp, "ULIBC: OpenMP Thread %3d, NUMA: %3d, LCore: %2d, #LCores, %2d, LLC: %3d, LLC-Core: %2d\n",
+	    ni.id, ni.node, ni.core, ni.lnp, ni.llc, ni.llc_core);
   }
 }
 
@@ -312,6 +387,41 @@ void ULIBC_print_thread_mapping(FILE *fp) {
 static int cmpr_scatter(const void *a, const void *b);
 static int cmpr_compact(const void *a, const void *b);
 static int cmpr_compact_avoid_ht(const void *a, const void *b);
+static int cmpr_scatter_llc(const void *a, const void *b);
+static int cmpr_compact_llc(const void *a, const void *b);
+static int cmpr_compact_avoid_ht_llc(const void *a, const void *b);
+static int cmpr_capacity_first(const void *a, const void *b);
+static int (*__cmpr_base)(const void *a, const void *b);
+
+/* physical LLC of proc as the lowest processor sharing it, or -1 (whole node) */
+static int llc_leader(int proc) {
+  return ULIBC_get_cache_info( ULIBC_get_cache_levels(), proc ).leader;
+}
+
+/* LLC index in the node and core index in the LLC of online processors */
+static void rank_llcs(void) {
+  const int n = ULIBC_get_max_online_procs();
+  for (int i = 0; i < n; ++i) {
+    const int pi = ULIBC_get_online_procidx(i);
+    const struct cpuinfo_t ci = ULIBC_get_cpuinfo(pi);
+    const int li = llc_leader(pi);
+    bitmap_t lower[MAX_CPUS/64] = {0};
+    int rank = 0, core = 0;
+    for (int j = 0; j < n; ++j) {
+      const int pj = ULIBC_get_online_procidx(j);
+      const struct cpuinfo_t cj = ULIBC_get_cpuinfo(pj);
+      const int lj = llc_leader(pj);
+      if ( cj.node != ci.node ) continue;
+      if ( 0 <= lj && lj < li && !ISSET_BITMAP(lower, lj) ) {
+	SET_BITMAP(lower, lj);
+	++rank;
+      }
+      if ( lj == li && cj.smt == ci.smt && cj.core < ci.core ) ++core;
+    }
+    __llc_rank[pi] = rank;
+    __llc_core_rank[pi] = core;
+  }
+}
 
 static void get_sorted_procs(int *proc_list) {
   /* fill sorted_list with online processors */
@@ -328,15 +438,27 @@ static void get_sorted_procs(int *proc_list) {
   
   /* detecting or sorting */
   if ( __use_affinity == ULIBC_AFFINITY ) {
+    const int llc = ( __binding_policy == THREAD_TO_LLC );
+    if ( llc ) rank_llcs();
+    __cmpr_base = NULL;
     switch ( __mapping_policy ) {
     case SCATTER_MAPPING:
-      qsort(proc_list, ULIBC_get_max_online_procs(), sizeof(int), cmpr_scatter);
+    case CAPACITY_SCATTER_MAPPING:
+      __cmpr_base = (llc) ? cmpr_scatter_llc : cmpr_scatter;
       break;
     case COMPACT_MAPPING:
-      qsort(proc_list, ULIBC_get_max_online_procs(), sizeof(int),
-	    (__avoid_htcore) ? cmpr_compact_avoid_ht : cmpr_compact);
+    case CAPACITY_COMPACT_MAPPING:
+      if ( llc )
+	__cmpr_base = (__avoid_htcore) ? cmpr_compact_avoid_ht_llc : cmpr_compact_llc;
+      else
+	__cmpr_base = (__avoid_htcore) ? cmpr_compact_avoid_ht : cmpr_compact;
       break;
     }
+    const int capacity = ( __mapping_policy == CAPACITY_SCATTER_MAPPING ||
+			   __mapping_policy == CAPACITY_COMPACT_MAPPING );
+    if ( __cmpr_base )
+      qsort(proc_list, ULIBC_get_max_online_procs(), sizeof(int),
+	    (capacity) ? cmpr_capacity_first : __cmpr_base);
   }
   if ( ULIBC_verbose() > 1 ) {
     printf("ULIBC: After: ");
@@ -350,6 +472,9 @@ static int cmpr_proc(const void *a, const void *b);
 static int cmpr_core(const void *a, const void *b);
 static int cmpr_node(const void *a, const void *b);
 static int cmpr_smt (const void *a, const void *b);
+static int cmpr_llc (const void *a, const void *b);
+static int cmpr_capacity(const void *a, const void *b);
+static int cmpr_llc_core(const void *a, const void *b);
 
 static int cmpr_scatter(const void *a, const void *b) {
   int ret;
@@ -377,6 +502,45 @@ static int cmpr_compact(const void *a, const void *b) {
   return ret;
 }
 
+/* LLC granularity: scatter spreads threads over the LLCs of all nodes,
+   and compact fills one LLC before the next one */
+static int cmpr_scatter_llc(const void *a, const void *b) {
+  int ret;
+  if ( (ret = cmpr_smt (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc_core(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_node(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_proc(a,b)) != 0 ) return ret;
+  return ret;
+}
+
+static int cmpr_compact_avoid_ht_llc(const void *a, const void *b) {
+  int ret = 0;
+  if ( (ret = cmpr_smt (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_node(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc_core(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_proc(a,b)) != 0 ) return ret;
+  return ret;
+}
+static int cmpr_compact_llc(const void *a, const void *b) {
+  int ret = 0;
+  if ( (ret = cmpr_node(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_smt (a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_llc_core(a,b)) != 0 ) return ret;
+  if ( (ret = cmpr_proc(a,b)) != 0 ) return ret;
+  return ret;
+}
+
+/* capacity first: performance cores, efficiency cores, and then SMT
+   siblings, each of which is ordered by the mapping */
+static int cmpr_capacity_first(const void *a, const void *b) {
+  int ret;
+  if ( (ret = cmpr_capacity(a,b)) != 0 ) return ret;
+  return __cmpr_base(a,b);
+}
+
 static int cmpr_proc(const void *a, const void *b) {
   const int _proc_a = ULIBC_get_cpuinfo(*(int *)a).id;
   const int _proc_b = ULIBC_get_cpuinfo(*(int *)b).id;
@@ -409,6 +573,33 @@ static int cmpr_smt(const void *a, const void *b) {
   return 0;
 }
 
+static int cmpr_capacity(const void *a, const void *b) {
+  const struct cpuinfo_t _ci_a = ULIBC_get_cpuinfo(*(int *)a);
+  const struct cpuinfo_t _ci_b = ULIBC_get_cpuinfo(*(int *)b);
+  if ( (_ci_a.smt > 0) != (_ci_b.smt > 0) ) return (_ci_a.smt > 0) ? 1 : -1;
+  if ( _ci_a.type < _ci_b.type ) return -1;
+  if ( _ci_a.type > _ci_b.type ) return  1;
+  if ( _ci_a.capacity > _ci_b.capacity ) return -1;
+  if ( _ci_a.capacity < _ci_b.capacity ) return  1;
+  return 0;
+}
+
+static int cmpr_llc(const void *a, const void *b) {
+  const int _llc_a = __llc_rank[*(int *)a];
+  const int _llc_b = __llc_rank[*(int *)b];
+  if ( _llc_a < _llc_b) return -1;
+  if ( _llc_a > _llc_b) return  1;
+  return 0;
+}
+
+static int cmpr_llc_core(const void *a, const void *b) {
+  const int _core_a = __llc_core_rank[*(int *)a];
+  const int _core_b = __llc_core_rank[*(int *)b];
+  if ( _core_a < _core_b) return -1;
+  if ( _core_a > _core_b) return  1;
+  return 0;
+}
+
 
 /* ------------------------------------------------------------
  * make NUMA layout table
@@ -427,24 +618,58 @@ static int make_numainfo(int *proc_list) {
   }
   
   /* construct numainfo and online_cores */
+  int onllcs = 0;
+  int llc_node[MAX_CPUS], llc_leaders[MAX_CPUS];
   for (int i = 0; i < onnodes; ++i) {
     __online_ncores_on_node[i] = 0;
   }
   for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
-    int node = 0;
+    int node = 0, llc = -1;
     int cpu = proc_list[i];
     struct cpuinfo_t ci = ULIBC_get_cpuinfo(cpu);
     for (int j = 0; j < onnodes; ++j) {
       if (__online_nodelist[j] == ci.node) node = j;
     }
+    /* an LLC never spans NUMA nodes (e.g. sub-NUMA clustering) */
+    const int leader = llc_leader(cpu);
+    for (int j = 0; j < onllcs; ++j) {
+      if (llc_node[j] == node && llc_leaders[j] == leader) llc = j;
+    }
+    if ( llc < 0 ) {
+      llc = onllcs++;
+      llc_node[llc] = node;
+      llc_leaders[llc] = leader;
+      __online_ncores_on_llc[llc] = 0;
+    }
     __numainfo[i].id   = i;	/* thread index */
     __numainfo[i].proc = cpu;	/* processor index for cpuinfo[] */
     __numainfo[i].node = node;	/* NUMA node index  */
     __numainfo[i].core = __online_ncores_on_node[node]++; /* NUMA core index */
+    __numainfo[i].llc  = llc;	/* LLC index */
+    __numainfo[i].llc_core = __online_ncores_on_llc[llc]++; /* LLC core index */
   }
+  __online_llcs = onllcs;
   for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
     __numainfo[i].lnp = __online_ncores_on_node[ __numainfo[i].node ];
   }
   
+  /* (node, core) to thread index */
+  for (int j = 0, base = 0; j < onnodes; ++j) {
+    __online_threadbase[j] = base;
+    base += __online_ncores_on_node[j];
+  }
+  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
+    __online_threadlist[ __online_threadbase[__numainfo[i].node] + __numainfo[i].core ] = i;
+  }
+  
+  /* (llc, llc_core) to thread index */
+  for (int j = 0, base = 0; j < onllcs; ++j) {
+    __online_llc_threadbase[j] = base;
+    base += __online_ncores_on_llc[j];
+  }
+  for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
+    __online_llc_threadlist[ __online_llc_threadbase[__numainfo[i].llc] + __numainfo[i].llc_core ] = i;
+  }
+  
   return onnodes;
 }
@@ -0,0 +1,285 @@
+/* ---------------------------------------------------------------------- *
+ *
+ * Copyright (C) 2013-2016 Yuichiro Yasui < yuichiro.yasui@gmail.com >
+ *
+ * This file is part of ULIBC.
+ *
+ * ULIBC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ULIBC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ULIBC.  If not, see <http://www.gnu.org/licenses/>.
+ * ---------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ulibc.h>
+#include <common.h>
+
+/* ------------------------------------------------------------
+ * Node-to-node distance probe
+ *   For each online NUMA node i, a thread bound to the first thread
+ *   of node i measures a buffer strictly bound to each node j
+ *   (ULIBC_MPOL_BIND, never spilled): pointer-chase latency (ns per
+ *   load) and streaming read/write bandwidth (GB/s). A pair whose
+ *   buffer is not resident on node j is left unmeasured (-1), as
+ *   checked by ULIBC_query_placement(). The pairs are measured
+ *   one by one, so that they do not disturb each other. The result
+ *   is kept as matrices indexed by [i][j] and can be saved to and
+ *   loaded from a text file.
+ * ------------------------------------------------------------ */
+#ifndef PROBE_DEFAULT_BYTES
+#define PROBE_DEFAULT_BYTES (1UL << 26)
+#endif
+#define PROBE_LINE    64
+#define PROBE_REPEATS 3
+#define PROBE_MAGIC   "ULIBC-probe"
+
+static int __probe_nodes = 0;
+static double *__probe = NULL;	/* [kind][from][to] */
+#define PROBE(k,i,j) __probe[ ((size_t)(k) * __probe_nodes + (i)) * __probe_nodes + (j) ]
+
+struct probe_arg_t {
+  int from;
+  size_t bytes;
+};
+
+static uint64_t xorshift64(uint64_t *x) {
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+}
+
+/* ns per dependent load over a random cyclic chain of cache lines */
+static double probe_latency(unsigned char *buf, size_t bytes) {
+  const size_t nlines = bytes / PROBE_LINE;
+  size_t *order = malloc( sizeof(size_t) * nlines );
+  if ( !order || nlines < 2 ) {
+    free(order);
+    return -1.0;
+  }
+  uint64_t seed = 88172645463325252ULL;
+  for (size_t i = 0; i < nlines; ++i)
+    order[i] = i;
+  for (size_t i = nlines-1; i > 0; --i) {
+    const size_t j = xorshift64(&seed) % (i+1);
+    const size_t t = order[i]; order[i] = order[j]; order[j] = t;
+  }
+  for (size_t i = 0; i < nlines; ++i)
+    *(void **)&buf[ order[i] * PROBE_LINE ] = &buf[ order[(i+1) % nlines] * PROBE_LINE ];
+  free(order);
+
+  const size_t steps = MIN(nlines, (size_t)1 << 22);
+  double best = -1.0;
+  for (int r = 0; r < PROBE_REPEATS; ++r) {
+    void * volatile *p = (void * volatile *)buf;
+    const double t = get_msecs();
+    for (size_t i = 0; i < steps; ++i)
+      p = (void * volatile *)*p;
+    const double ns = (get_msecs() - t) * 1e6 / steps;
+    if ( p && (best < 0 || ns < best) ) best = ns;
+  }
+  return best;
+}
+
+/* GB/s of streaming reads (write = 0) or writes (write = 1) */
+static double probe_bandwidth(unsigned char *buf, size_t bytes, int write) {
+  uint64_t *x = (uint64_t *)buf;
+  const size_t n = bytes / sizeof(uint64_t);
+  double best = 0.0;
+  for (int r = 0; r < PROBE_REPEATS; ++r) {
+    volatile uint64_t sink = 0;
+    uint64_t s = 0;
+    const double t = get_msecs();
+    if ( write ) {
+      for (size_t i = 0; i < n; ++i)
+	x[i] = i;
+    } else {
+      for (size_t i = 0; i < n; ++i)
+	s += x[i];
+    }
+    sink = s;
+    (void)sink;
+    const double sec = (get_msecs() - t) * 1e-3;
+    if ( sec > 0 )
+      best = MAX(best, (double)bytes / sec / (1UL<<30));
+  }
+  return best;
+}
+
+/* whether most resident pages of buf are on the physical node; true if unknown */
+static int probe_placed(const unsigned char *buf, size_t bytes, int node) {
+  size_t per_node[MAX_NODES];
+  const size_t resident = ULIBC_query_placement(buf, bytes, per_node);
+  return resident == 0 || per_node[node] >= resident / 10 * 9;
+}
+
+static void *pth_probe(void *arg) {
+  const struct probe_arg_t *pa = arg;
+  const int from = pa->from;
+  ULIBC_bind_thread_explicit( ULIBC_get_online_thread(from, 0) );
+
+  for (int to = 0; to < __probe_nodes; ++to) {
+    unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+    SET_BITMAP( (uint64_t *)nodemask, ULIBC_get_online_nodeidx(to) );
+    unsigned char *buf = ULIBC_malloc_explict(pa->bytes, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+    if ( !buf ) continue;
+    memset(buf, 0, pa->bytes);
+    if ( !probe_placed(buf, pa->bytes, ULIBC_get_online_nodeidx(to)) ) {
+      if ( ULIBC_verbose() )
+	printf("ULIBC: probe buffer of NUMA-node %d is not resident on the node\n", to);
+      ULIBC_free(buf);
+      continue;
+    }
+    PROBE(ULIBC_PROBE_WRITE_BW, from, to) = probe_bandwidth(buf, pa->bytes, 1);
+    PROBE(ULIBC_PROBE_READ_BW, from, to)  = probe_bandwidth(buf, pa->bytes, 0);
+    PROBE(ULIBC_PROBE_LATENCY, from, to)  = probe_latency(buf, pa->bytes);
+    ULIBC_free(buf);
+
+    if ( ULIBC_verbose() )
+      printf("ULIBC: probe NUMA-node %d -> %d: %.1f ns, read %.2f GB/s, write %.2f GB/s\n",
+	     from, to, PROBE(ULIBC_PROBE_LATENCY, from, to),
+	     PROBE(ULIBC_PROBE_READ_BW, from, to), PROBE(ULIBC_PROBE_WRITE_BW, from, to));
+  }
+  return NULL;
+}
+
+/* measures all pairs of online NUMA nodes with bytes (0: 64 MB) per buffer */
+int ULIBC_probe_distance(size_t bytes) {
+  if ( bytes == 0 ) bytes = PROBE_DEFAULT_BYTES;
+  bytes = ROUNDUP(bytes, PROBE_LINE);
+  const int nnodes = ULIBC_get_online_nodes();
+  const size_t n = (size_t)ULIBC_PROBE_MAX * nnodes * nnodes;
+  double *probe = realloc( __probe, sizeof(double) * n );
+  if ( !probe ) return -1;
+  __probe = probe;
+  __probe_nodes = nnodes;
+  for (size_t i = 0; i < n; ++i)
+    __probe[i] = -1.0;
+
+  for (int from = 0; from < __probe_nodes; ++from) {
+    struct probe_arg_t pa = { .from = from, .bytes = bytes };
+    pthread_t pth;
+    if ( pthread_create(&pth, NULL, pth_probe, &pa) ) {
+      __probe_nodes = 0;
+      return -1;
+    }
+    pthread_join(pth, NULL);
+  }
+  return 0;
+}
+
+/* cached file if it matches the online nodes, or a new measurement saved to it */
+int ULIBC_probe_distance_cached(const char *path, size_t bytes) {
+  if ( path && !ULIBC_load_probe(path) )
+    return 0;
+  if ( ULIBC_probe_distance(bytes) )
+    return -1;
+  if ( path && ULIBC_save_probe(path) && ULIBC_verbose() )
+    printf("ULIBC: cannot save the probe to %s\n", path);
+  return 0;
+}
+
+int ULIBC_get_probe_nodes(void) {
+  return __probe_nodes;
+}
+
+/* measured cost from the from-th to the to-th online node, or -1 */
+double ULIBC_get_probe(int kind, int from, int to) {
+  if ( kind < 0 || ULIBC_PROBE_MAX <= kind ) return -1.0;
+  if ( from < 0 || __probe_nodes <= from || to < 0 || __probe_nodes <= to ) return -1.0;
+  return PROBE(kind, from, to);
+}
+
+const char *ULIBC_get_probe_name(int kind) {
+  switch (kind) {
+  case ULIBC_PROBE_LATENCY:  return "latency_ns";
+  case ULIBC_PROBE_READ_BW:  return "read_gbps";
+  case ULIBC_PROBE_WRITE_BW: return "write_gbps";
+  default:                   return "unknown";
+  }
+}
+
+
+/* --------------------
+ * probe file
+ *   ULIBC-probe <#nodes>
+ *   latency_ns
+ *   <#nodes x #nodes values>
+ *   read_gbps
+ *   ...
+ * -------------------- */
+int ULIBC_save_probe(const char *path) {
+  if ( __probe_nodes == 0 ) return -1;
+  FILE *fp = fopen(path, "w");
+  if ( !fp ) return -1;
+  fprintf(fp, "%s %d\n", PROBE_MAGIC, __probe_nodes);
+  for (int k = 0; k < ULIBC_PROBE_MAX; ++k) {
+    fprintf(fp, "%s\n", ULIBC_get_probe_name(k));
+    for (int i = 0; i < __probe_nodes; ++i) {
+      for (int j = 0; j < __probe_nodes; ++j)
+	fprintf(fp, "%s%.3f", j ? " " : "", PROBE(k, i, j));
+      fprintf(fp, "\n");
+    }
+  }
+  fclose(fp);
+  return 0;
+}
+
+int ULIBC_load_probe(const char *path) {
+  FILE *fp = fopen(path, "r");
+  if ( !fp ) return -1;
+  char magic[32], name[32];
+  int nnodes = 0, ok = 1;
+  if ( fscanf(fp, "%31s %d", magic, &nnodes) != 2 || strcmp(magic, PROBE_MAGIC) ||
+       nnodes != ULIBC_get_online_nodes() )
+    ok = 0;
+  double *probe = ok ? malloc( sizeof(double) * ULIBC_PROBE_MAX * nnodes * nnodes ) : NULL;
+  for (int k = 0; probe && ok && k < ULIBC_PROBE_MAX; ++k) {
+    if ( fscanf(fp, "%31s", name) != 1 || strcmp(name, ULIBC_get_probe_name(k)) )
+      ok = 0;
+    for (int i = 0; ok && i < nnodes * nnodes; ++i)
+      if ( fscanf(fp, "%lf", &probe[(size_t)k * nnodes * nnodes + i]) != 1 ) ok = 0;
+  }
+  fclose(fp);
+  if ( !probe || !ok ) {
+    free(probe);
+    if ( ULIBC_verbose() )
+      printf("ULIBC: %s is not a probe of %d NUMA nodes\n", path, ULIBC_get_online_nodes());
+    return -1;
+  }
+
+  free(__probe);
+  __probe = probe;
+  __probe_nodes = nnodes;
+  if ( ULIBC_verbose() )
+    printf("ULIBC: loaded the probe of %d NUMA nodes from %s\n", nnodes, path);
+  return 0;
+}
+
+void ULIBC_print_probe(FILE *fp) {
+  for (int k = 0; k < ULIBC_PROBE_MAX; ++k) {
+    fprintf(fp, "%s\n", ULIBC_get_probe_name(k));
+    fprintf(fp, "%6s", "from");
+    for (int j = 0; j < __probe_nodes; ++j)
+      fprintf(fp, " %9d", j);
+    fprintf(fp, "\n");
+    for (int i = 0; i < __probe_nodes; ++i) {
+      fprintf(fp, "%6d", i);
+      for (int j = 0; j < __probe_nodes; ++j)
+	fprintf(fp, " %9.2f", PROBE(k, i, j));
+      fprintf(fp, "\n");
+    }
+  }
+}
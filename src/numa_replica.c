@@ -0,0 +1,98 @@
+/* ---------------------------------------------------------------------- *
+ *
+ * Copyright (C) 2013-2016 Yuichiro Yasui < yuichiro.yasui@gmail.com >
+ *
+ * This file is part of ULIBC.
+ *
+ * ULIBC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ULIBC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ULIBC.  If not, see <http://www.gnu.org/licenses/>.
+ * ---------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulibc.h>
+#include <common.h>
+
+/* ------------------------------------------------------------
+ * NUMA-replicated read-only data
+ *   Each online NUMA node has its own node-bound copy, which is
+ *   written by the threads on that node. Readers take the copy of
+ *   their own node by ULIBC_replica_local().
+ * ------------------------------------------------------------ */
+struct ulibc_replica_t {
+  size_t size;
+  int nnodes;
+  void *copy[MAX_NODES];
+};
+
+/* copies src into all replicas; each node's threads write their share */
+static void fill_replicas(struct ulibc_replica_t *r, const void *src) {
+  OMP("omp parallel") {
+    const struct numainfo_t cur = ULIBC_get_current_numainfo();
+    /* covers all shares even if fewer threads are running */
+    for (int t = omp_get_thread_num(); t < ULIBC_get_online_procs(); t += omp_get_num_threads()) {
+      const struct numainfo_t ni = ( t == cur.id ) ? cur : ULIBC_get_numainfo(t);
+      long ls, le;
+      prange(r->size, 0, ni.lnp, ni.core, &ls, &le);
+      unsigned char *dst = r->copy[ni.node];
+      if ( dst != src && ls < le )
+	memcpy( &dst[ls], (const unsigned char *)src + ls, le-ls );
+    }
+  }
+}
+
+struct ulibc_replica_t *ULIBC_replicate(const void *src, size_t size) {
+  struct ulibc_replica_t *r = calloc( 1, sizeof(struct ulibc_replica_t) );
+  if ( !r ) return NULL;
+  r->size = size;
+  r->nnodes = ULIBC_get_online_nodes();
+  for (int k = 0; k < r->nnodes; ++k) {
+    r->copy[k] = ULIBC_malloc_bind( MAX(size, (size_t)1), k );
+    if ( !r->copy[k] ) {
+      ULIBC_replica_free(r);
+      return NULL;
+    }
+    ULIBC_mark_touched( r->copy[k] );	/* filled below, never by the touchers */
+  }
+  if ( src )
+    fill_replicas(r, src);
+  
+  if ( ULIBC_verbose() > 1 )
+    printf("ULIBC: replicate %p (%ld bytes) on %d NUMA nodes\n", src, size, r->nnodes);
+  return r;
+}
+
+/* re-synchronizes all replicas with src; NULL propagates the copy of the 0th node */
+void ULIBC_replica_refresh(struct ulibc_replica_t *r, const void *src) {
+  if ( !r ) return;
+  fill_replicas(r, src ? src : r->copy[0]);
+}
+
+/* returns the copy of the calling thread's NUMA node, which binds the thread */
+void *ULIBC_replica_local(const struct ulibc_replica_t *r) {
+  const int node = ULIBC_get_current_numainfo().node;
+  return r->copy[ node < r->nnodes ? node : 0 ];
+}
+
+/* returns the copy of the node-th online NUMA node */
+void *ULIBC_replica_node(const struct ulibc_replica_t *r, int node) {
+  return r->copy[ (0 <= node && node < r->nnodes) ? node : 0 ];
+}
+
+void ULIBC_replica_free(struct ulibc_replica_t *r) {
+  if ( !r ) return;
+  for (int k = 0; k < r->nnodes; ++k)
+    ULIBC_free( r->copy[k] );
+  free(r);
+}
@@ -0,0 +1,249 @@
+/* ---------------------------------------------------------------------- *
+ *
+ * Copyright (C) 2013-2016 Yuichiro Yasui < yuichiro.yasui@gmail.com >
+ *
+ * This file is part of ULIBC.
+ *
+ * ULIBC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ULIBC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ULIBC.  If not, see <http://www.gnu.org/licenses/>.
+ * ---------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <ulibc.h>
+#include <common.h>
+
+/* ------------------------------------------------------------
+ * Per-node slab allocator
+ *   Each NUMA node owns a set of node-bound chunks (SLAB_CHUNK_SIZE),
+ *   which are divided into runs (SLAB_RUN_SIZE). A run serves objects
+ *   of a single size class. The run header is placed at the aligned
+ *   head of each run, so that ULIBC_node_free() finds it from the
+ *   object address. Objects larger than SLAB_MAX_SIZE are allocated
+ *   separately, with a run header in front of them.
+ * ------------------------------------------------------------ */
+#ifndef SLAB_CHUNK_SIZE
+#define SLAB_CHUNK_SIZE (1UL << 21)
+#endif
+#ifndef SLAB_RUN_SIZE
+#define SLAB_RUN_SIZE (1UL << 16)
+#endif
+#ifndef SLAB_PAGE_SIZE
+#define SLAB_PAGE_SIZE (1UL << 12)
+#endif
+#define SLAB_HEADER_SIZE 64
+#define SLAB_MIN_SHIFT   4
+#define SLAB_MAX_SHIFT   13
+#define SLAB_MAX_SIZE    (1UL << SLAB_MAX_SHIFT)
+#define SLAB_NCLASSES    (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_MAGIC       0x51ab51abU
+#define SLAB_LARGE       (-1)
+
+struct slab_run_t {
+  uint32_t magic;
+  int node;			/* NUMA node index */
+  int cls;			/* size class or SLAB_LARGE */
+  uint32_t nobjs;		/* #objects in this run */
+  uint32_t nfree;		/* #free objects */
+  uint32_t nbump;		/* #objects carved by bump pointer */
+  void *freelist;		/* freed objects */
+  void *base;			/* allocated address (SLAB_LARGE only) */
+  struct slab_run_t *prev, *next;
+};
+
+static struct slab_node_t {
+  pthread_mutex_t lock;
+  struct slab_run_t *partial[SLAB_NCLASSES]; /* runs having free objects */
+  struct slab_run_t *freeruns;		      /* unused runs */
+  size_t nchunks;
+} __slab[MAX_NODES];
+
+static pthread_once_t __slab_once = PTHREAD_ONCE_INIT;
+
+static void init_slab_nodes(void) {
+  assert( sizeof(struct slab_run_t) <= SLAB_HEADER_SIZE );
+  for (int k = 0; k < MAX_NODES; ++k) {
+    pthread_mutex_init(&__slab[k].lock, NULL);
+    for (int c = 0; c < SLAB_NCLASSES; ++c)
+      __slab[k].partial[c] = NULL;
+    __slab[k].freeruns = NULL;
+    __slab[k].nchunks = 0;
+  }
+}
+
+static int slab_class(size_t size) {
+  int cls = 0;
+  while ( (1UL << (cls + SLAB_MIN_SHIFT)) < size )
+    ++cls;
+  return cls;
+}
+
+static size_t slab_objsize(int cls) {
+  return 1UL << (cls + SLAB_MIN_SHIFT);
+}
+
+static size_t slab_offset(int cls) {
+  return MAX( slab_objsize(cls), (size_t)SLAB_HEADER_SIZE );
+}
+
+/* --------------------
+ * run lists
+ * -------------------- */
+static void push_run(struct slab_run_t **head, struct slab_run_t *r) {
+  r->prev = NULL;
+  r->next = *head;
+  if ( *head ) (*head)->prev = r;
+  *head = r;
+}
+
+static void remove_run(struct slab_run_t **head, struct slab_run_t *r) {
+  if ( r->prev ) r->prev->next = r->next;
+  else           *head = r->next;
+  if ( r->next ) r->next->prev = r->prev;
+  r->prev = r->next = NULL;
+}
+
+/* requires __slab[node].lock */
+static int grow_slab_node(int node) {
+  unsigned char *p = ULIBC_malloc_bind(SLAB_CHUNK_SIZE, node);
+  if ( !p ) return 0;
+  ULIBC_mark_touched(p);		/* holds run headers and live objects */
+
+  const uintptr_t tail = (uintptr_t)p + SLAB_CHUNK_SIZE;
+  uintptr_t r = ROUNDUP( (uintptr_t)p, SLAB_RUN_SIZE );
+  for ( ; r + SLAB_RUN_SIZE <= tail; r += SLAB_RUN_SIZE) {
+    struct slab_run_t *run = (struct slab_run_t *)r;
+    run->magic = SLAB_MAGIC;
+    run->node  = node;
+    push_run( &__slab[node].freeruns, run );
+  }
+  ++__slab[node].nchunks;
+
+  if ( ULIBC_verbose() > 1 )
+    printf("ULIBC: slab chunk %p (%lu bytes) on NUMA-node %d\n",
+	   p, SLAB_CHUNK_SIZE, node);
+  return 1;
+}
+
+/* requires __slab[node].lock */
+static struct slab_run_t *new_slab_run(int node, int cls) {
+  if ( !__slab[node].freeruns && !grow_slab_node(node) )
+    return NULL;
+  struct slab_run_t *run = __slab[node].freeruns;
+  remove_run( &__slab[node].freeruns, run );
+  run->cls      = cls;
+  run->nobjs    = (SLAB_RUN_SIZE - slab_offset(cls)) / slab_objsize(cls);
+  run->nfree    = run->nobjs;
+  run->nbump    = 0;
+  run->freelist = NULL;
+  run->base     = NULL;
+  return run;
+}
+
+/* --------------------
+ * large objects
+ * -------------------- */
+static void *large_node_alloc(size_t size, int node) {
+  unsigned long nodemask[MAX_NODES/sizeof(unsigned long)/8] = {0};
+  SET_BITMAP( (uint64_t *)nodemask, ULIBC_get_online_nodeidx(node) );
+  const size_t bytes = ROUNDUP( size + SLAB_RUN_SIZE, SLAB_PAGE_SIZE );
+  void *p = ULIBC_malloc_explict(bytes, ULIBC_MPOL_BIND, nodemask, MAX_NODES);
+  if ( !p ) return NULL;
+  ULIBC_mark_touched(p);
+
+  struct slab_run_t *run = (struct slab_run_t *)ROUNDUP( (uintptr_t)p, SLAB_RUN_SIZE );
+  run->magic = SLAB_MAGIC;
+  run->node  = node;
+  run->cls   = SLAB_LARGE;
+  run->base  = p;
+  return (unsigned char *)run + SLAB_HEADER_SIZE;
+}
+
+
+/* ------------------------------------------------------------
+ * ULIBC_node_alloc
+ * ------------------------------------------------------------ */
+void *ULIBC_node_alloc(size_t size, int node) {
+  pthread_once( &__slab_once, init_slab_nodes );
+  if ( node < 0 || ULIBC_get_online_nodes() <= node )
+    return NULL;
+  if ( size == 0 ) size = 1;
+  if ( size > SLAB_MAX_SIZE )
+    return large_node_alloc(size, node);
+
+  const int cls = slab_class(size);
+  struct slab_node_t *sn = &__slab[node];
+  void *obj = NULL;
+
+  pthread_mutex_lock( &sn->lock );
+  struct slab_run_t *run = sn->partial[cls];
+  if ( !run ) {
+    run = new_slab_run(node, cls);
+    if ( run ) push_run( &sn->partial[cls], run );
+  }
+  if ( run ) {
+    if ( run->freelist ) {
+      obj = run->freelist;
+      run->freelist = *(void **)obj;
+    } else {
+      obj = (unsigned char *)run + slab_offset(cls) + run->nbump * slab_objsize(cls);
+      ++run->nbump;
+    }
+    if ( --run->nfree == 0 )
+      remove_run( &sn->partial[cls], run );
+  }
+  pthread_mutex_unlock( &sn->lock );
+  return obj;
+}
+
+void ULIBC_node_free(void *ptr) {
+  if ( !ptr ) return;
+
+  struct slab_run_t *run = (struct slab_run_t *)ALIGN_DOWN( (uintptr_t)ptr, SLAB_RUN_SIZE );
+  assert( run->magic == SLAB_MAGIC );
+  if ( run->cls == SLAB_LARGE ) {
+    ULIBC_free( run->base );
+    return;
+  }
+
+  struct slab_node_t *sn = &__slab[run->node];
+  pthread_mutex_lock( &sn->lock );
+  *(void **)ptr = run->freelist;
+  run->freelist = ptr;
+  if ( run->nfree++ == 0 )
+    push_run( &sn->partial[run->cls], run );
+  if ( run->nfree == run->nobjs ) {
+    remove_run( &sn->partial[run->cls], run );
+    push_run( &sn->freeruns, run );
+  }
+  pthread_mutex_unlock( &sn->lock );
+}
+
+/* drops all runs; their chunks are released by ULIBC_all_free(), so the
+   loop counters and barriers carved from them are dropped as well */
+void ULIBC_clear_node_alloc(void) {
+  pthread_once( &__slab_once, init_slab_nodes );
+  for (int k = 0; k < MAX_NODES; ++k) {
+    pthread_mutex_lock( &__slab[k].lock );
+    for (int c = 0; c < SLAB_NCLASSES; ++c)
+      __slab[k].partial[c] = NULL;
+    __slab[k].freeruns = NULL;
+    __slab[k].nchunks = 0;
+    pthread_mutex_unlock( &__slab[k].lock );
+  }
+  ULIBC_clear_numa_loops();
+  ULIBC_clear_numa_barriers();
+}
@@ -121,10 +121,24 @@ void ULIBC_print_topology(FILE *fp) {
 	    k, ULIBC_get_num_nodes(), ncores_per_socket[k],
 	    1.0*ULIBC_memory_size(k)/(1UL<<30), ULIBC_page_size(k));
   }
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    fprintf(fp, "ULIBC: Package %3d of %d distances {", k, ULIBC_get_num_nodes());
+    for (int j = 0; j < ULIBC_get_num_nodes(); ++j)
+      fprintf(fp, " %d", ULIBC_get_node_distance(k, j));
+    fprintf(fp, " }\n");
+  }
+  for (int level = 1; level <= ULIBC_get_cache_levels(); ++level) {
+    const struct cacheinfo_t c = ULIBC_get_cache_info(level, 0);
+    if ( !c.level ) continue;
+    fprintf(fp, "ULIBC: L%d %s cache of CPU 0 is %ld KB (%d-bytes line, %d-way) shared by %d CPUs\n",
+	    c.level, c.type == ULIBC_CACHE_DATA ? "data" : "unified",
+	    c.size >> 10, c.line, c.ways, c.nshared);
+  }
   for (int i = 0; i < ULIBC_get_num_procs(); ++i) {
     struct cpuinfo_t ci = ULIBC_get_cpuinfo(i);
-    fprintf(fp, "ULIBC: CPU[%03d] Processor: %2d, Package: %2d, Core: %2d, SMT: %2d\n",
-	    i, ci.id, ci.node, ci.core, ci.smt);
+    fprintf(fp, "ULIBC: CPU[%03d] Processor: %2d, Package: %2d, Core: %2d, SMT: %2d, %s-core (%4d)\n",
+	    i, ci.id, ci.node, ci.core, ci.smt,
+	    ci.type == ULIBC_CORE_EFFICIENCY ? "E" : "P", ci.capacity);
   }
 }
 
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ulibc.h>
+
+/* measures the node-to-node latency and bandwidth matrices */
+int main(int argc, char **argv) {
+  ULIBC_init();
+  
+  size_t size = 1UL << 26;
+  const char *cache = NULL;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  if (argc > 2) cache = argv[2];
+  printf("usage: %s [MB per buffer (default: 64)] [cache file]\n", argv[0]);
+  printf("# of NUMA nodes is %d, buffer size is %.1f MB\n",
+	 ULIBC_get_online_nodes(), (double)size/(1UL<<20));
+  
+  const int err = cache ?
+    ULIBC_probe_distance_cached(cache, size) : ULIBC_probe_distance(size);
+  if ( err ) {
+    printf("probe failed\n");
+    ULIBC_finalize();
+    return 1;
+  }
+  ULIBC_print_probe(stdout);
+  
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ulibc.h>
+#include <omp_helpers.h>
+
+/* compares the first-touch strategies of ULIBC_touch_memory_pool{,_naive} */
+static double run(int naive, int touch, int nbufs, size_t size) {
+  void **addr = malloc(sizeof(void *) * nbufs);
+  for (int k = 0; k < nbufs; ++k) {
+    if ( k % 2 == 1 )
+      addr[k] = ULIBC_malloc_interleave( size );
+    else
+      addr[k] = ULIBC_malloc_bind( size, k % ULIBC_get_online_nodes() );
+  }
+  
+  ULIBC_set_touch_policy(touch);
+  const double t1 = omp_get_wtime();
+  if ( naive )
+    ULIBC_touch_memory_pool_naive();
+  else
+    ULIBC_touch_memory_pool();
+  const double t2 = omp_get_wtime();
+  
+  for (int k = 0; k < nbufs; ++k)
+    ULIBC_free( addr[k] );
+  free(addr);
+  return t2 - t1;
+}
+
+int main(int argc, char **argv) {
+  ULIBC_init();
+  
+  int nbufs = 64;
+  size_t size = 1UL << 26;
+  if (argc > 1) nbufs = atoi(argv[1]);
+  if (argc > 2) size = atol(argv[2]) << 20;
+  printf("usage: %s [#buffers (default: 64)] [MB per buffer (default: 64)]\n", argv[0]);
+  printf("# of buffers is %d, buffer size is %.1f MB, page policy is %s\n",
+	 nbufs, (double)size/(1UL<<20), ULIBC_get_page_name( ULIBC_get_page_policy() ));
+  
+  const double gb = (double)nbufs * size / (1UL<<30);
+  printf("%8s %10s %12s %10s\n", "touch", "routine", "time (ms)", "GB/s");
+  for (int touch = 0; touch < ULIBC_TOUCH_MAX; ++touch) {
+    for (int naive = 1; naive >= 0; --naive) {
+      const double t = run(naive, touch, nbufs, size);
+      printf("%8s %10s %12.3f %10.3f\n", ULIBC_get_touch_name(touch),
+	     naive ? "naive" : "pool", t * 1e3, gb / t);
+    }
+  }
+  
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ulibc.h>
+#include <omp_helpers.h>
+
+#define NOBJS 4096
+
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  size_t size = 64;
+  if (argc > 1) size = atol(argv[1]);
+  printf("usage: %s [object size (default: 64)]\n", argv[0]);
+  printf("object size is %lu bytes\n", size);
+
+  double t1, t2, t3;
+  int failed = 0;
+  t1 = omp_get_wtime();
+  OMP("omp parallel reduction(+:failed)") {
+    struct numainfo_t ni = ULIBC_get_current_numainfo();
+    unsigned char **objs = malloc(sizeof(unsigned char *) * NOBJS);
+
+    /* allocates small node-local objects */
+    for (int i = 0; i < NOBJS; ++i) {
+      objs[i] = ULIBC_node_alloc(size, ni.node);
+      memset(objs[i], ni.id & 0xff, size);
+    }
+    OMP("omp barrier");
+
+    /* validates contents, which the pool toucher never overwrites */
+    OMP("omp single")
+      ULIBC_touch_memory_pool();
+    for (int i = 0; i < NOBJS; ++i) {
+      for (size_t j = 0; j < size; ++j)
+	if ( objs[i][j] != (unsigned char)(ni.id & 0xff) ) ++failed;
+    }
+    OMP("omp barrier");
+
+    /* releases */
+    for (int i = 0; i < NOBJS; ++i) {
+      ULIBC_node_free(objs[i]);
+    }
+    free(objs);
+  }
+  t2 = omp_get_wtime();
+
+  /* reuses the runs */
+  OMP("omp parallel") {
+    struct numainfo_t ni = ULIBC_get_current_numainfo();
+    for (int i = 0; i < NOBJS; ++i) {
+      ULIBC_node_free( ULIBC_node_alloc(size, ni.node) );
+    }
+  }
+  t3 = omp_get_wtime();
+
+  const double nobjs = (double)NOBJS * ULIBC_get_online_procs();
+  printf("# of threads is %d, # of objects is %.0f\n", ULIBC_get_online_procs(), nobjs);
+  printf("alloc/check/free: %f ms (%.3f M objs/sec)\n", (t2-t1)*1e3, nobjs/(t2-t1)*1e-6);
+  printf("alloc/free:       %f ms (%.3f M objs/sec)\n", (t3-t2)*1e3, nobjs/(t3-t2)*1e-6);
+  printf("memory usage is %.3f MB\n", (double)ULIBC_memory_usage()/(1UL<<20));
+  assert( failed == 0 );
+  assert( ULIBC_node_alloc(size, -1) == NULL );
+  assert( ULIBC_node_alloc(size, ULIBC_get_online_nodes()) == NULL );
+
+  /* large objects as well */
+  unsigned char *large = ULIBC_node_alloc(1UL << 16, 0);
+  memset(large, 0x5a, 1UL << 16);
+  ULIBC_touch_memory_pool();
+  for (size_t j = 0; j < (1UL << 16); ++j)
+    assert( large[j] == 0x5a );
+  ULIBC_node_free(large);
+
+  /* the loop counters are allocated again after finalize */
+  ULIBC_finalize();
+  ULIBC_init();
+  int64_t sum = 0;
+  OMP("omp parallel reduction(+:sum)") {
+    int64_t ls, le;
+    ULIBC_clear_numa_loop(0, 1 << 20);
+    OMP("omp barrier");
+    OMP("omp single")
+      ULIBC_touch_memory_pool();
+    while ( !ULIBC_numa_loop(64, &ls, &le) )
+      sum += le - ls;
+  }
+  printf("numa loop after re-init: %ld of %d per node\n", (long)sum, 1 << 20);
+  assert( sum == (int64_t)ULIBC_get_online_nodes() << 20 );
+
+  ULIBC_finalize();
+  return 0;
+}
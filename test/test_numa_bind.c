@@ -23,7 +23,7 @@ int main(void) {
 
   printf("\n");
   const int a_policy[] = { SCATTER_MAPPING, COMPACT_MAPPING, -1 };
-  const int b_policy[] = { THREAD_TO_THREAD, THREAD_TO_CORE, THREAD_TO_SOCKET, -1 };
+  const int b_policy[] = { THREAD_TO_THREAD, THREAD_TO_CORE, THREAD_TO_LLC, THREAD_TO_SOCKET, -1 };
   void test(void);
   for (int i = 0; a_policy[i] >= 0; ++i) {
     for (int j = 0; b_policy[j] >= 0; ++j) {
@@ -43,9 +43,9 @@ void test(void) {
   for (int i = 0; i < ULIBC_get_online_procs(); ++i) {
     struct numainfo_t ni = ULIBC_get_numainfo(i);
     struct cpuinfo_t ci = ULIBC_get_cpuinfo( ni.proc );
-    printf("Thread: %3d of %d, NUMA: %2d-%02d (core=%2d)"
+    printf("Thread: %3d of %d, NUMA: %2d-%02d (core=%2d), LLC: %2d-%02d"
   	   ", Proc: %2d, Pkg: %2d, Core: %2d, Smt: %2d\n",
-  	   ni.id, ULIBC_get_online_procs(), ni.node, ni.core, ni.lnp,
+  	   ni.id, ULIBC_get_online_procs(), ni.node, ni.core, ni.lnp, ni.llc, ni.llc_core,
   	   ci.id, ci.node, ci.core, ci.smt);
   }
 }
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <ulibc.h>
+
+/* #VMAs overlapping [p, p+len) in /proc/self/maps */
+static long count_vmas(const void *p, size_t len) {
+  FILE *fp = fopen("/proc/self/maps", "r");
+  if ( !fp ) return -1;
+  char line[4096];
+  long n = 0;
+  while ( fgets(line, sizeof(line), fp) ) {
+    unsigned long start, end;
+    if ( sscanf(line, "%lx-%lx", &start, &end) == 2 &&
+	 start < (uintptr_t)p + len && (uintptr_t)p < end )
+      ++n;
+  }
+  fclose(fp);
+  return n;
+}
+
+static long max_map_count(void) {
+  long n = 65530;
+  FILE *fp = fopen("/proc/sys/vm/max_map_count", "r");
+  if ( fp ) {
+    if ( fscanf(fp, "%ld", &n) != 1 ) n = 65530;
+    fclose(fp);
+  }
+  return n;
+}
+
+/* per-call chunk sizes, and the VMA limit of chunk-interleaved allocations */
+int main(void) {
+  ULIBC_init();
+  const int nnodes = ULIBC_get_online_nodes();
+  const size_t global = ULIBC_get_interleave_chunk();
+
+  /* chunks given per call are kept by each allocation */
+  const size_t size = 1UL << 26;
+  unsigned char *x = ULIBC_malloc_chunk_interleave(size, 1UL << 18, NULL);
+  unsigned char *y = ULIBC_malloc_chunk_interleave(size, 1UL << 16, NULL);
+  assert( x && y );
+  assert( ULIBC_get_interleave_unit(x) == (1UL << 18) );
+  assert( ULIBC_get_interleave_unit(y) == (1UL << 16) );
+  assert( ULIBC_get_interleave_chunk() == global );
+  for (size_t c = 0; c < size >> 18; ++c)
+    assert( ULIBC_get_interleave_node(x, c << 18) == ULIBC_get_online_nodeidx(c % nnodes) );
+  printf("chunk %zu: %ld VMAs, chunk %zu: %ld VMAs\n",
+	 ULIBC_get_interleave_unit(x), count_vmas(x, size),
+	 ULIBC_get_interleave_unit(y), count_vmas(y, size));
+  ULIBC_touch_memory_pool();
+  ULIBC_free(x);
+  ULIBC_free(y);
+
+  /* the global chunk grows to keep the VMAs below the limit */
+  const long limit = max_map_count() / 8;
+  const size_t large = (size_t)limit * 4 << 12;
+  ULIBC_set_interleave_chunk(1UL << 12);
+  unsigned char *z = ULIBC_malloc_mempol(large, ULIBC_MPOL_CHUNK_INTERLEAVE);
+  assert( z );
+  printf("global chunk 4096: unit %zu, %ld VMAs (limit: %ld)\n",
+	 ULIBC_get_interleave_unit(z), count_vmas(z, large), limit);
+  assert( count_vmas(z, large) <= limit );
+  ULIBC_free(z);
+  ULIBC_set_interleave_chunk(global);
+
+  /* whereas a chunk given per call fails instead */
+  z = ULIBC_malloc_chunk_interleave(large, 1UL << 12, NULL);
+  if ( nnodes > 1 ) {
+    assert( !z );
+    printf("chunk 4096 of %zu bytes is refused\n", large);
+  } else {
+    assert( z && ULIBC_get_interleave_unit(z) == (1UL << 12) );
+    ULIBC_free(z);
+  }
+
+  ULIBC_finalize();
+  return 0;
+}
@@ -22,12 +22,15 @@ int main(int argc, char **argv) {
   }
   
   int64_t static_loop(int64_t n);
+  int64_t weighted_loop(int64_t n);
   int64_t dynamic_loop(int64_t n, int64_t chunk);
+  int64_t llc_loop(int64_t n, int64_t chunk);
   
   printf("#procs   is %d\n", ULIBC_get_num_procs());
   printf("#nodes   is %d\n", ULIBC_get_num_nodes());
   printf("#cores   is %d\n", ULIBC_get_num_cores());
   printf("#smt     is %d\n", ULIBC_get_num_smts());
+  printf("#llcs    is %d\n", ULIBC_get_online_llcs());
   printf("\n");
   
   int64_t n = 1ULL << scale;
@@ -36,17 +39,24 @@ int main(int argc, char **argv) {
   printf("total is %lld\n", (long long)total);
   printf("\n");
   
-  double s_time, d_time;
-  int64_t total_static, total_dynamic;
+  double s_time, w_time, d_time, l_time;
+  int64_t total_static, total_weighted, total_dynamic, total_llc;
   TIMED( s_time, total_static  = static_loop(n) );
+  TIMED( w_time, total_weighted = weighted_loop(n) );
   TIMED( d_time, total_dynamic = dynamic_loop(n, chunk) );
+  TIMED( l_time, total_llc     = llc_loop(n, chunk) );
   
   printf("\n");
   printf("total_static  is %lld (%.3f ms)\n", (long long)total_static, s_time);
+  printf("total_weighted is %lld (%.3f ms)\n", (long long)total_weighted, w_time);
   printf("total_dynamic is %lld (chunk: %d) (%.3f ms)\n",
 	 (long long)total_dynamic, chunk, d_time);
+  printf("total_llc     is %lld (chunk: %d) (%.3f ms)\n",
+	 (long long)total_llc, chunk, l_time);
   assert( total_static == total );
+  assert( total_weighted == total );
   assert( total_dynamic == total );
+  assert( total_llc == total );
   
   return 0;
 }
@@ -69,6 +79,20 @@ int64_t static_loop(int64_t n) {
   return total;
 }
 
+int64_t weighted_loop(int64_t n) {
+  int64_t total = 0;
+  OMP("omp parallel reduction(+:total)") {
+    struct numainfo_t ni = ULIBC_get_current_numainfo();
+    int64_t node_ls, node_le, ls, le;
+    ULIBC_numa_range(n+1, 0, ni.node, &node_ls, &node_le);
+    ULIBC_thread_range(node_le-node_ls, node_ls, ni.id, &ls, &le);
+    for (int64_t i = ls; i < le; ++i) {
+      total += i;
+    }
+  }
+  return total;
+}
+
 int64_t dynamic_loop(int64_t n, int64_t chunk) {
   int64_t total = 0;
   OMP("omp parallel reduction(+:total)") {
@@ -88,6 +112,25 @@ int64_t dynamic_loop(int64_t n, int64_t chunk) {
   return total;
 }
 
+int64_t llc_loop(int64_t n, int64_t chunk) {
+  int64_t total = 0;
+  OMP("omp parallel reduction(+:total)") {
+    struct numainfo_t ni = ULIBC_get_current_numainfo();
+    int64_t llc_ls, llc_le;
+    range(n+1, 0, ULIBC_get_online_llcs(), ni.llc, &llc_ls, &llc_le);
+    ULIBC_clear_llc_loop(llc_ls, llc_le);
+    ULIBC_llc_barrier();
+    
+    int64_t ls, le;
+    while ( !ULIBC_llc_loop(chunk, &ls, &le) ) {
+      for (int64_t i = ls; i < le; ++i) {
+	total += i;
+      }
+    }
+  }
+  return total;
+}
+
 void range(int64_t len, int64_t off, int64_t np, int64_t id, int64_t *ls, int64_t *le) {
   const int64_t qt = len / np;
   const int64_t rm = len % np;
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <ulibc.h>
+
+/* #VMAs overlapping [p, p+len) in /proc/self/maps */
+static int count_vmas(const void *p, size_t len) {
+  FILE *fp = fopen("/proc/self/maps", "r");
+  if ( !fp ) return -1;
+  char line[4096];
+  int n = 0;
+  while ( fgets(line, sizeof(line), fp) ) {
+    unsigned long start, end;
+    if ( sscanf(line, "%lx-%lx", &start, &end) == 2 &&
+	 start < (uintptr_t)p + len && (uintptr_t)p < end )
+      ++n;
+  }
+  fclose(fp);
+  return n;
+}
+
+/* ULIBC_rebind() moves the resident pages onto the new nodes in place */
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  size_t size = 1UL << 27;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB (default: 128)]\n", argv[0]);
+
+  const size_t n = size / sizeof(size_t);
+  size_t *x = ULIBC_malloc_interleave(size);
+  assert( x );
+  ULIBC_touch_memory_pool();
+  for (size_t i = 0; i < n; ++i)
+    x[i] = i;
+
+  size_t usage[256];
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    const int node = ULIBC_get_online_nodeidx(k);
+    unsigned long nodemask[4] = {0};
+    nodemask[node / 64] |= 1UL << (node % 64);
+    assert( ULIBC_rebind(x + n/2, ULIBC_MPOL_BIND, nodemask) == 0 );
+
+    const size_t resident = ULIBC_query_placement(x, size, usage);
+    printf("rebound to NUMA-node %d: %.1f MB of %.1f MB resident on it, %d VMA(s)\n", node,
+	   (double)usage[node]/(1UL<<20), (double)resident/(1UL<<20), count_vmas(x, size));
+    assert( resident == 0 || usage[node] >= resident / 10 * 9 );
+    assert( count_vmas(x, size) == 1 );
+  }
+  for (size_t i = 0; i < n; ++i)
+    assert( x[i] == i );
+
+  /* striped policies are recorded with their stripes, and plain ones drop them */
+  unsigned long online[4] = {0};
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    const int node = ULIBC_get_online_nodeidx(k);
+    online[node / 64] |= 1UL << (node % 64);
+  }
+  assert( ULIBC_rebind(x, ULIBC_MPOL_CHUNK_INTERLEAVE, online) == 0 );
+  const size_t unit = ULIBC_get_interleave_unit(x);
+  assert( unit > 0 );
+  for (size_t off = 0; off < size; off += unit)
+    assert( ULIBC_get_interleave_node(x, off) ==
+	    ULIBC_get_online_nodeidx( (off / unit) % ULIBC_get_online_nodes() ) );
+  printf("re-striped by %zu bytes, %d VMA(s)\n", unit, count_vmas(x, size));
+  assert( ULIBC_rebind(x, ULIBC_MPOL_INTERLEAVE, online) == 0 );
+  assert( ULIBC_get_interleave_unit(x) == 0 && ULIBC_get_interleave_node(x, 0) == -1 );
+  for (size_t i = 0; i < n; ++i)
+    assert( x[i] == i );
+  ULIBC_print_memory_pool_mode(ULIBC_PRINT_RESIDENCY);
+  ULIBC_free(x);
+
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <ulibc.h>
+
+static int check(const unsigned char *x, size_t len) {
+  for (size_t i = 0; i < len; ++i)
+    if ( x[i] != (unsigned char)(i % 251) ) return 0;
+  return 1;
+}
+
+/* the pool touchers never overwrite the contents of mapped files */
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  size_t size = 1UL << 24;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB per file (default: 16)]\n", argv[0]);
+
+  char path[64];
+  sprintf(path, "/tmp/ulibc-test-%d", (int)getpid());
+  FILE *fp = fopen(path, "w");
+  assert( fp );
+  for (size_t i = 0; i < size; ++i)
+    fputc( (int)(i % 251), fp );
+  fclose(fp);
+
+  unsigned char *priv = ULIBC_mmap_file(path, 0, 0, ULIBC_MPOL_INTERLEAVE, NULL, ULIBC_MMAP_PRIVATE);
+  unsigned char *shrd = ULIBC_mmap_file(path, 0, 0, ULIBC_MPOL_INTERLEAVE, NULL, ULIBC_MMAP_SHARED);
+  unsigned char *pref = ULIBC_mmap_file(path, 0, 0, ULIBC_MPOL_INTERLEAVE, NULL,
+					ULIBC_MMAP_SHARED | ULIBC_MMAP_PREFAULT);
+  assert( priv && shrd && pref );
+
+  ULIBC_touch_memory_pool();
+  ULIBC_touch_memory_pool_naive();
+  ULIBC_touch_memory_pool_async();
+  assert( ULIBC_touch_async(shrd) == 0 );
+  ULIBC_wait_touched(priv);
+  ULIBC_wait_touched(shrd);
+  ULIBC_wait_touched(pref);
+
+  assert( check(priv, size) );
+  assert( check(shrd, size) );
+  assert( check(pref, size) );
+  ULIBC_print_memory_pool();
+  ULIBC_free(priv);
+  ULIBC_free(shrd);
+  ULIBC_free(pref);
+
+  /* ranges beyond the end of the file are refused instead of SIGBUS */
+  assert( !ULIBC_mmap_file(path, 0, size + (1UL << 20), ULIBC_MPOL_INTERLEAVE, NULL,
+			   ULIBC_MMAP_PRIVATE | ULIBC_MMAP_PREFAULT) );
+  assert( !ULIBC_mmap_file(path, size + (1UL << 12), 0, ULIBC_MPOL_INTERLEAVE, NULL, ULIBC_MMAP_PRIVATE) );
+  pref = ULIBC_mmap_file(path, 1UL << 12, size - (1UL << 12), ULIBC_MPOL_INTERLEAVE, NULL,
+			 ULIBC_MMAP_PRIVATE | ULIBC_MMAP_PREFAULT);
+  assert( pref && pref[0] == (unsigned char)((1UL << 12) % 251) );
+  ULIBC_free(pref);
+
+  /* striped policies stripe the mapping as ULIBC_malloc_*() */
+  pref = ULIBC_mmap_file(path, 0, 0, ULIBC_MPOL_CHUNK_INTERLEAVE, NULL,
+			 ULIBC_MMAP_PRIVATE | ULIBC_MMAP_PREFAULT);
+  assert( pref && ULIBC_get_interleave_unit(pref) > 0 );
+  assert( ULIBC_get_interleave_node(pref, 0) == ULIBC_get_online_nodeidx(0) );
+  assert( check(pref, size) );
+  ULIBC_free(pref);
+
+  /* the file itself */
+  unsigned char *x = malloc(size);
+  fp = fopen(path, "r");
+  assert( fp && fread(x, 1, size, fp) == size );
+  fclose(fp);
+  unlink(path);
+  assert( check(x, size) );
+  free(x);
+  printf("%.1f MB file kept its contents\n", (double)size/(1UL<<20));
+
+  ULIBC_finalize();
+  return 0;
+}
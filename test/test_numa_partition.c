@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ulibc.h>
+#include <omp_helpers.h>
+
+void range(int64_t len, int64_t off, int64_t np, int64_t id, int64_t *ls, int64_t *le);
+
+int main(int argc, char **argv) {
+  ULIBC_init();
+  
+  int scale = 20;
+  printf("usage: %s [SCALE (default: 20)]\n", argv[0]);
+  if (argc > 1) scale = atoi(argv[1]);
+  const int64_t n = (1LL << scale) + 12345;
+  printf("n is %lld (SCALE: %d)\n", (long long)n, scale);
+  
+  struct ulibc_partition_t part;
+  double *vec = ULIBC_malloc_partitioned(n, sizeof(double), &part);
+  assert( vec );
+  
+  /* owner-computes */
+  int64_t failed = 0;
+  OMP("omp parallel reduction(+:failed)") {
+    struct numainfo_t ni = ULIBC_get_current_numainfo();
+    int64_t node_ls, node_le, ls, le;
+    ULIBC_partition_range(&part, ni.node, &node_ls, &node_le);
+    range(node_le-node_ls, node_ls, ni.lnp, ni.core, &ls, &le);
+    for (int64_t i = ls; i < le; ++i) {
+      vec[i] = i;
+      if ( ULIBC_partition_node(&part, i) != ni.node ) ++failed;
+      if ( ULIBC_partition_thread(&part, i) != ni.id ) ++failed;
+    }
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    if ( vec[i] != (double)i ) ++failed;
+  }
+  
+  /* placement of each node's block */
+  size_t bytes[256];
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    int64_t ls, le;
+    ULIBC_partition_range(&part, k, &ls, &le);
+    ULIBC_query_placement(&vec[ls], (le-ls) * sizeof(double), bytes);
+    printf("node %d: [%lld, %lld) on NUMA-node %d, %.3f MB resident\n", k,
+	   (long long)ls, (long long)le, ULIBC_get_online_nodeidx(k),
+	   (double)bytes[ ULIBC_get_online_nodeidx(k) ]/(1UL<<20));
+  }
+  
+  /* owners are threads on the owner node under other mappings */
+  const int maps[] = { COMPACT_MAPPING, SCATTER_MAPPING };
+  for (int m = 0; m < 2; ++m) {
+    ULIBC_set_affinity_policy(ULIBC_get_online_procs(), maps[m], THREAD_TO_CORE);
+    for (int64_t i = 0; i < n; i += 997) {
+      const int t = ULIBC_partition_thread(&part, i);
+      if ( t < 0 || ULIBC_get_online_procs() <= t ) ++failed;
+      else if ( ULIBC_get_numainfo(t).node != ULIBC_partition_node(&part, i) ) ++failed;
+    }
+  }
+  printf("failed is %lld\n", (long long)failed);
+  assert( failed == 0 );
+  
+  ULIBC_free(vec);
+  ULIBC_finalize();
+  return 0;
+}
+
+void range(int64_t len, int64_t off, int64_t np, int64_t id, int64_t *ls, int64_t *le) {
+  const int64_t qt = len / np;
+  const int64_t rm = len % np;
+  *ls = qt * (id+0) + (id+0 < rm ? id+0 : rm) + off;
+  *le = qt * (id+1) + (id+1 < rm ? id+1 : rm) + off;
+}
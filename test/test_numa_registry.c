@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <ulibc.h>
+
+#define NSLOTS 64
+
+static volatile int stop = 0;
+static void *volatile slots[NSLOTS];
+
+/* looks up interior pointers while the main thread frees them */
+static void *reader(void *arg) {
+  long k = 0;
+  (void)arg;
+  while ( !stop ) {
+    unsigned char *p = slots[k++ % NSLOTS];
+    if ( p ) {
+      ULIBC_wait_touched(p + 100);
+      ULIBC_get_interleave_unit(p);
+    }
+    if ( k % 97 == 0 )
+      ULIBC_touch_memory_pool_async();
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  long iters = 20000;
+  if (argc > 1) iters = atol(argv[1]);
+  printf("usage: %s [#allocations (default: 20000)]\n", argv[0]);
+
+  /* interior pointers */
+  unsigned char *x = ULIBC_malloc_interleave(1UL << 22);
+  unsigned char *y = ULIBC_malloc_interleave(1UL << 22);
+  assert( x && y );
+  assert( ULIBC_wait_touched(x) == 0 );
+  assert( ULIBC_wait_touched(x + (1UL << 22) - 1) == 0 );
+  assert( ULIBC_wait_touched(y + 12345) == 0 );
+  ULIBC_free(y);
+  assert( ULIBC_wait_touched(y + 12345) == -1 );
+  ULIBC_free(x);
+
+  pthread_t th[3];
+  for (int i = 0; i < 3; ++i)
+    pthread_create(&th[i], NULL, reader, NULL);
+  for (long i = 0; i < iters; ++i) {
+    void *old = slots[i % NSLOTS];
+    slots[i % NSLOTS] = ULIBC_malloc_interleave(1UL << 16);
+    ULIBC_free(old);
+  }
+  stop = 1;
+  for (int i = 0; i < 3; ++i)
+    pthread_join(th[i], NULL);
+  printf("%ld allocations freed under concurrent lookups\n", iters);
+
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ulibc.h>
+#include <omp_helpers.h>
+
+/* the touchers never overwrite replicated data, and each thread reads its node's copy */
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  size_t size = 1UL << 24;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB (default: 16)]\n", argv[0]);
+
+  unsigned char *src = malloc(size);
+  for (size_t i = 0; i < size; ++i)
+    src[i] = (unsigned char)(i * 7 + 1);
+
+  struct ulibc_replica_t *r = ULIBC_replicate(src, size);
+  assert( r );
+  ULIBC_touch_memory_pool();
+  ULIBC_touch_memory_pool_async();
+  for (int k = 0; k < ULIBC_get_online_nodes(); ++k) {
+    ULIBC_wait_touched( ULIBC_replica_node(r, k) );
+    assert( !memcmp( ULIBC_replica_node(r, k), src, size ) );
+  }
+
+  int failed = 0;
+  OMP("omp parallel reduction(+:failed)") {
+    const unsigned char *local = ULIBC_replica_local(r);
+    if ( local != ULIBC_replica_node(r, ULIBC_get_current_numainfo().node) ) ++failed;
+    if ( memcmp(local, src, size) ) ++failed;
+  }
+  printf("%d NUMA-node copies of %.1f MB, failed is %d\n",
+	 ULIBC_get_online_nodes(), (double)size/(1UL<<20), failed);
+  assert( failed == 0 );
+
+  ULIBC_replica_free(r);
+  free(src);
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <ulibc.h>
+
+/* a producer process fills a node-bound shared segment, and a consumer attaches it */
+int main(int argc, char **argv) {
+  ULIBC_init();
+  
+  size_t size = 1UL << 26;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB per segment (default: 64)]\n", argv[0]);
+  
+  char name[64];
+  sprintf(name, "/ulibc-test-%d", (int)getpid());
+  const int node = ULIBC_get_online_nodes() - 1;
+  unsigned long nodemask[4] = {0};
+  nodemask[ ULIBC_get_online_nodeidx(node) / 64 ] |= 1UL << (ULIBC_get_online_nodeidx(node) % 64);
+  
+  size_t *x = ULIBC_shm_create(name, size, ULIBC_MPOL_BIND, nodemask);
+  assert( x );
+  ULIBC_touch_memory_pool();
+  ULIBC_wait_touched(x);
+  const size_t n = size / sizeof(size_t);
+  for (size_t i = 0; i < n; ++i)
+    x[i] = i;
+  
+  const pid_t pid = fork();
+  if ( pid == 0 ) {
+    size_t *y = ULIBC_shm_attach(name, 0, ULIBC_MPOL_DEFAULT, NULL);
+    int failed = ( !y || ULIBC_shm_size(name) != size );
+    ULIBC_touch_memory_pool();	/* never touches attached segments */
+    for (size_t i = 0; !failed && i < n; ++i) {
+      if ( y[i] != i ) failed = 1;
+      y[i] = n - i;
+    }
+    ULIBC_free(y);
+    /* an attacher with its own policy keeps the contents as well */
+    y = ULIBC_shm_attach(name, size, ULIBC_MPOL_INTERLEAVE, NULL);
+    ULIBC_touch_memory_pool();
+    for (size_t i = 0; !failed && i < n; ++i)
+      if ( !y || y[i] != n - i ) failed = 1;
+    ULIBC_free(y);
+    _exit(failed);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ULIBC_shm_unlink(name);
+  assert( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+  
+  for (size_t i = 0; i < n; ++i)
+    assert( x[i] == n - i );
+  
+  size_t usage[256] = {0};
+  ULIBC_query_placement(x, size, usage);
+  printf("segment of %.1f MB on NUMA-node %d: %.1f MB resident\n",
+	 (double)size/(1UL<<20), node, (double)usage[ ULIBC_get_online_nodeidx(node) ]/(1UL<<20));
+  ULIBC_print_memory_pool();
+  ULIBC_free(x);
+  
+  /* anonymous segment shared with children */
+  int *flag = ULIBC_shm_create(NULL, sizeof(int), ULIBC_MPOL_INTERLEAVE, NULL);
+  assert( flag );
+  ULIBC_wait_touched(flag);
+  *flag = 0;
+  if ( fork() == 0 ) {
+    *flag = 1;
+    _exit(0);
+  }
+  wait(NULL);
+  assert( *flag == 1 );
+  ULIBC_free(flag);
+  
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <ulibc.h>
+
+static const int policies[] = {
+  ULIBC_MPOL_DEFAULT, ULIBC_MPOL_BIND, ULIBC_MPOL_INTERLEAVE,
+  ULIBC_MPOL_WEIGHTED_INTERLEAVE, ULIBC_MPOL_CHUNK_INTERLEAVE, ULIBC_MPOL_LOCAL,
+};
+#define NPOLICIES (int)(sizeof(policies)/sizeof(policies[0]))
+
+static long iters = 2000;
+
+static size_t node_bytes(void) {
+  struct ulibc_alloc_stats_t st;
+  size_t sum = 0;
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    assert( ULIBC_get_alloc_stats(ULIBC_STATS_NODE, k, &st) == 0 );
+    sum += st.bytes;
+  }
+  return sum;
+}
+
+static void *worker(void *arg) {
+  const long id = (long)arg;
+  for (long i = 0; i < iters; ++i) {
+    void *p = ULIBC_malloc_mempol(1UL << 16, policies[(id + i) % NPOLICIES]);
+    assert( p );
+    ULIBC_free(p);
+  }
+  return NULL;
+}
+
+/* the node counters add up to the live bytes under concurrent allocations */
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  if (argc > 1) iters = atol(argv[1]);
+  printf("usage: %s [#allocations per thread (default: 2000)]\n", argv[0]);
+
+  struct ulibc_alloc_stats_t base, st;
+  ULIBC_get_alloc_stats(ULIBC_STATS_TOTAL, 0, &base);
+
+  pthread_t th[4];
+  for (long i = 0; i < 4; ++i)
+    pthread_create(&th[i], NULL, worker, (void *)i);
+  for (int i = 0; i < 4; ++i)
+    pthread_join(th[i], NULL);
+
+  ULIBC_get_alloc_stats(ULIBC_STATS_TOTAL, 0, &st);
+  printf("%zu allocations, %zu frees, %zu bytes live\n",
+	 st.nallocs - base.nallocs, st.nfrees - base.nfrees, st.bytes);
+  assert( st.nallocs - base.nallocs == 4 * (size_t)iters );
+  assert( st.nfrees - base.nfrees == 4 * (size_t)iters );
+  assert( st.bytes == base.bytes && st.count == base.count );
+  assert( node_bytes() == base.bytes );
+
+  const size_t size = 3UL << 21;
+  void *x[NPOLICIES];
+  for (int i = 0; i < NPOLICIES; ++i) {
+    x[i] = ULIBC_malloc_mempol(size, policies[i]);
+    assert( x[i] );
+  }
+  ULIBC_get_alloc_stats(ULIBC_STATS_TOTAL, 0, &st);
+  assert( node_bytes() == st.bytes );
+  ULIBC_touch_memory_pool();
+  assert( node_bytes() == st.bytes );
+
+  for (int k = 0; k < ULIBC_get_num_nodes(); ++k) {
+    ULIBC_get_alloc_stats(ULIBC_STATS_NODE, k, &st);
+    printf("NUMA-node %d: %zu bytes in %zu allocations\n", k, st.bytes, st.count);
+  }
+  for (int i = 0; i < NPOLICIES; ++i)
+    ULIBC_free(x[i]);
+  assert( node_bytes() == base.bytes );
+
+  ULIBC_finalize();
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <ulibc.h>
+
+/* the asynchronous touch never overwrites data written while it is queued */
+int main(int argc, char **argv) {
+  ULIBC_init();
+
+  size_t size = 1UL << 28;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB per allocation (default: 256)]\n", argv[0]);
+
+  ULIBC_set_touch_async(1);
+  const size_t n = size / sizeof(size_t);
+  for (int r = 0; r < 2; ++r) {
+    ULIBC_set_touch_policy(r ? ULIBC_TOUCH_POPULATE : ULIBC_TOUCH_STRIDE);
+    size_t *x = ULIBC_malloc_interleave(size);
+    assert( x );
+    for (size_t i = 0; i < n; ++i)
+      x[i] = i;
+    ULIBC_wait_touched(x);
+    for (size_t i = 0; i < n; ++i)
+      assert( x[i] == i );
+    ULIBC_free(x);
+    printf("%.1f MB written during the asynchronous touch (%s): ok\n",
+	   (double)size/(1UL<<20), ULIBC_get_touch_name( ULIBC_get_touch_policy() ));
+  }
+
+  ULIBC_finalize();
+  return 0;
+}
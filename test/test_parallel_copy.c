@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ulibc.h>
+#include <omp_helpers.h>
+
+/* checks ULIBC_parallel_memcpy/memset and ULIBC_calloc_* on each policy */
+int main(int argc, char **argv) {
+  ULIBC_init();
+  
+  size_t size = 1UL << 26;
+  if (argc > 1) size = atol(argv[1]) << 20;
+  printf("usage: %s [MB per buffer (default: 64)]\n", argv[0]);
+  printf("buffer size is %.1f MB\n", (double)size/(1UL<<20));
+  
+  unsigned char *src = malloc(size);
+  for (size_t i = 0; i < size; ++i)
+    src[i] = (unsigned char)(i * 7 + 1);
+  
+  for (int mpol = 0; mpol < ULIBC_MPOL_MAX; ++mpol) {
+    unsigned char *x = ULIBC_calloc_mempol(size, 1, mpol);
+    unsigned char *y = ULIBC_malloc_mempol(size, mpol);
+    assert( x && y );
+    for (size_t i = 0; i < size; ++i)
+      assert( x[i] == 0 );
+    
+    /* unaligned ranges */
+    const double t1 = omp_get_wtime();
+    ULIBC_parallel_memcpy(y + 3, src + 3, size - 5);
+    const double t2 = omp_get_wtime();
+    ULIBC_parallel_memset(x + 1, 0x5a, size - 2);
+    const double t3 = omp_get_wtime();
+    for (size_t i = 3; i < size - 2; ++i)
+      assert( y[i] == src[i] );
+    for (size_t i = 1; i < size - 1; ++i)
+      assert( x[i] == 0x5a );
+    assert( x[0] == 0 && x[size-1] == 0 );
+    
+    printf("%20s memcpy %8.3f GB/s, memset %8.3f GB/s\n", ULIBC_get_mempol_name(mpol),
+	   size / (t2-t1) / (1UL<<30), size / (t3-t2) / (1UL<<30));
+    ULIBC_free(x);
+    ULIBC_free(y);
+  }
+  
+  /* an unregistered destination is split evenly */
+  unsigned char *z = malloc(size);
+  ULIBC_parallel_memcpy(z, src, size);
+  assert( !memcmp(z, src, size) );
+  free(z);
+  free(src);
+  
+  ULIBC_finalize();
+  return 0;
+}